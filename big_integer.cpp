@@ -1,4 +1,8 @@
 #include "big_integer.h"
+#include "thread_pool.h"
+#include "limb_kernels.h"
+#include "host_endian.h"
+#include "big_integer_trace.h"
 
 #include <utility>
 #include <vector>
@@ -7,8 +11,91 @@
 #include <cstddef>
 #include <iosfwd>
 #include <iostream>
+#include <sstream>
 #include <algorithm>
 #include <functional>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+char const LOWER_DIGITS[] = "0123456789abcdefghijklmnopqrstuvwxyz";
+char const UPPER_DIGITS[] = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ";
+char const BASE64_DIGITS[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+void check_base(unsigned base) {
+	if ((base < 2 || base > 36) && base != 64) {
+		throw std::invalid_argument("big_integer: unsupported base " + std::to_string(base));
+	}
+}
+
+char const *digit_alphabet(unsigned base) {
+	return base == 64 ? BASE64_DIGITS : LOWER_DIGITS;
+}
+
+// Value of the digit c in base, or -1 if c is not one
+int digit_value(int c, unsigned base) {
+	if (base == 64) {
+		char const *pos = c > 0 ? std::strchr(BASE64_DIGITS, c) : nullptr;
+		return pos ? static_cast<int>(pos - BASE64_DIGITS) : -1;
+	}
+	int value = -1;
+	if (c >= '0' && c <= '9') {
+		value = c - '0';
+	} else if (c >= 'a' && c <= 'z') {
+		value = c - 'a' + 10;
+	} else if (c >= 'A' && c <= 'Z') {
+		value = c - 'A' + 10;
+	}
+	return value < static_cast<int>(base) ? value : -1;
+}
+
+uint32_t checked_digit_value(std::string const &str, size_t pos, unsigned base) {
+	int value = digit_value(static_cast<unsigned char>(str[pos]), base);
+	if (value < 0) {
+		throw std::invalid_argument("big_integer: bad digit in \"" + str + "\"");
+	}
+	return static_cast<uint32_t>(value);
+}
+
+// log2(base) for powers of two, 0 for other bases
+unsigned power_of_two_bits(unsigned base) {
+	return (base & (base - 1)) == 0 ? __builtin_ctz(base) : 0;
+}
+
+// The largest power of base that fits in a limb and its exponent
+std::pair<uint32_t, size_t> limb_chunk(unsigned base) {
+	uint32_t chunk = base;
+	size_t digits = 1;
+	while (chunk <= UINT32_MAX / base) {
+		chunk *= base;
+		++digits;
+	}
+	return std::make_pair(chunk, digits);
+}
+
+unsigned stream_base(std::ios_base::fmtflags basefield) {
+	return basefield == std::ios_base::hex ? 16 : basefield == std::ios_base::oct ? 8 : 10;
+}
+
+// Sign and base prefix that the flags ask for, as the built-in integers print them
+std::string stream_prefix(std::ios_base::fmtflags flags, big_integer_view value) {
+	std::string prefix;
+	if (value.is_negative()) {
+		prefix += '-';
+	} else if (flags & std::ios_base::showpos) {
+		prefix += '+';
+	}
+	if ((flags & std::ios_base::showbase) && value.size() > 0) {
+		std::ios_base::fmtflags base = flags & std::ios_base::basefield;
+		if (base == std::ios_base::hex) {
+			prefix += flags & std::ios_base::uppercase ? "0X" : "0x";
+		} else if (base == std::ios_base::oct) {
+			prefix += '0';
+		}
+	}
+	return prefix;
+}
+}
 
 /* * * * * * * * * Constructors & destructor * * * * * * * * * */
 
@@ -35,26 +122,63 @@ big_integer::big_integer(int a) : sign_(false), data_() {
 	}
 }
 
-big_integer::big_integer(std::string const &str) {
-	big_integer res = big_integer();
-	sign_ = false;
+big_integer::big_integer(std::string const &str) : big_integer(str, 10) {}
+
+big_integer::big_integer(std::string const &str, unsigned base) : sign_(false), data_(0) {
+	trace_scope scope;
+	check_base(base);
 	size_t i = 0;
-	if (str[i] == '-') {
-		sign_ = true;
+	if (i < str.size() && (str[i] == '-' || (str[i] == '+' && base != 64))) {
+		sign_ = str[i] == '-';
 		++i;
 	}
-	if (str[i] == '+') {
-		++i;
+	if (i == str.size()) {
+		throw std::invalid_argument("big_integer: no digits in \"" + str + "\"");
 	}
-	for (; i < str.size(); ++i) {
-		res = res * 10 + (str[i] - '0');
+
+	unsigned bits = power_of_two_bits(base);
+	if (bits) {
+		// the last digit is the least significant one, pack bits from there
+		data_.resize((str.size() - i) * bits / 32 + 1);
+		uint32_t *data = data_.data();
+		size_t bit = 0;
+		for (size_t j = str.size(); j-- > i; bit += bits) {
+			uint32_t value = checked_digit_value(str, j, base);
+			data[bit / 32] |= value << (bit % 32);
+			if (bit % 32 + bits > 32) {
+				data[bit / 32 + 1] |= value >> (32 - bit % 32);
+			}
+		}
+	} else {
+		std::pair<uint32_t, size_t> chunk = limb_chunk(base);
+		size_t digit_bits = 32 - __builtin_clz(base - 1);
+		data_.reserve((str.size() - i) * digit_bits / 32 + 1);
+		uint32_t value = 0;
+		uint32_t value_scale = 1;
+		for (; i < str.size(); ++i) {
+			value = value * base + checked_digit_value(str, i, base);
+			value_scale *= base;
+			if (value_scale == chunk.first) {
+				multiply_add(value_scale, value);
+				value = 0;
+				value_scale = 1;
+			}
+		}
+		if (value_scale > 1) {
+			multiply_add(value_scale, value);
+		}
 	}
-	data_ = res.data_;
 	trim();
+	scope.record(trace_op::from_string, *this, base);
 }
 
 big_integer::big_integer(uint32_t a) : sign_(false), data_(a) {}
 
+big_integer::big_integer(big_integer_view const &view) : sign_(view.is_negative()), data_(0) {
+	data_.resize(std::max<size_t>(view.size(), 1));
+	std::copy(view.data(), view.data() + view.size(), data_.data());
+}
+
 big_integer::big_integer(bool sign, buffer &data) {
 	sign_ = sign;
 	data_ = data;
@@ -67,11 +191,15 @@ big_integer::~big_integer() = default;
 big_integer &big_integer::operator=(big_integer const &other) = default;
 
 big_integer &big_integer::operator+=(big_integer const &rhs) {
-	return *this = *this + rhs;
+	trace_scope scope;
+	scope.record(trace_op::add, *this, rhs);
+	return add_in_place(rhs, false);
 }
 
 big_integer &big_integer::operator-=(big_integer const &rhs) {
-	return *this = *this - rhs;
+	trace_scope scope;
+	scope.record(trace_op::subtract, *this, rhs);
+	return add_in_place(rhs, true);
 }
 
 big_integer &big_integer::operator*=(big_integer const &rhs) {
@@ -99,7 +227,21 @@ big_integer &big_integer::operator^=(big_integer const &rhs) {
 }
 
 big_integer &big_integer::operator<<=(uint32_t rhs) {
-	return *this = *this << rhs;
+	big_integer_view value(*this);
+	trace_scope scope;
+	scope.record(trace_op::shift_left, value, rhs);
+	size_t size = value.size();
+	size_t shift_digits = rhs / 32;
+	unsigned shift_number = rhs % 32;
+
+	data_.resize(size + shift_digits + 1);
+	uint32_t *data = data_.data();
+	if (shift_number) {
+		data[size] = limb_kernels::get().lshift(data, data, size, shift_number);
+	}
+	std::copy_backward(data, data + size + 1, data + size + shift_digits + 1);
+	std::fill(data, data + shift_digits, 0);
+	return trim();
 }
 
 big_integer &big_integer::operator>>=(uint32_t rhs) {
@@ -144,336 +286,516 @@ big_integer big_integer::operator--(int) {
 
 /* * * * * * * * * Binary operators (+, -, *) * * * * * * * * * */
 
-big_integer operator+(big_integer a, big_integer const &b) {
-	if (a.sign_ ^ b.sign_) {
-		return a - -b;
-	}
-
-	uint32_t carry = 0;
-	size_t res_size = std::max(a.data_.size(), b.data_.size());
-	a.data_.resize(res_size);
-	for (size_t i = 0; i < res_size; ++i) {
-		uint32_t a_digit = a.data_[i];
-		uint32_t b_digit = i < b.data_.size() ? b.data_[i] : 0;
+big_integer operator+(big_integer const &a, big_integer const &b) {
+	return big_integer_view(a) + big_integer_view(b);
+}
 
-		uint32_t curr_carry = carry;
-		uint64_t res_digit = a_digit + b_digit;
+big_integer operator-(big_integer const &a, big_integer const &b) {
+	return big_integer_view(a) - big_integer_view(b);
+}
 
-		if (a_digit > UINT32_MAX - b_digit || res_digit > UINT32_MAX - curr_carry) {
-			carry = 1;
-			res_digit &= UINT32_MAX;
-		} else {
-			carry = 0;
-		}
+big_integer operator*(big_integer const &a, big_integer const &b) {
+	return big_integer_view(a) * big_integer_view(b);
+}
 
-		a.data_[i] = res_digit + curr_carry;
+big_integer operator+(big_integer_view a, big_integer_view b) {
+	big_integer::trace_scope scope;
+	scope.record(trace_op::add, a, b);
+	if (a.is_negative() != b.is_negative() && a.size() > 0 && b.size() > 0) {
+		return a - -b;
 	}
+	if (a.size() < b.size()) {
+		std::swap(a, b);
+	}
+
+	big_integer res;
+	res.data_.resize(a.size() + 1);
+	uint32_t *res_data = res.data_.data();
+	uint32_t carry = limb_kernels::get().add_n(res_data, a.data(), b.data(), b.size());
+	res_data[a.size()] = limb_kernels::add_1(res_data + b.size(), a.data() + b.size(), a.size() - b.size(), carry);
 
-	a.data_.push_back(carry);
-	return a.trim();
+	res.sign_ = a.is_negative();
+	return res.trim();
 }
 
-big_integer operator-(big_integer a, big_integer const &b) {
-	if (a.sign_ == 0 && b.sign_ == 1) {
-		return a += -b;
-	}
-	if (a.sign_ == 1 && b.sign_ == 0) {
-		return -(-a + b);
+big_integer operator-(big_integer_view a, big_integer_view b) {
+	big_integer::trace_scope scope;
+	scope.record(trace_op::subtract, a, b);
+	if (a.is_negative() != b.is_negative()) {
+		return a + -b;
 	}
-	if (a.sign_ == 1 && b.sign_ == 1) {
-		return -(-a - -b);
+	bool sign = a.is_negative();
+	if (big_integer::compare_magnitude(a, b) < 0) {
+		std::swap(a, b);
+		sign = !sign;
 	}
-	if (a < b) {
-		return -(b - a);
-	}
-
-	uint32_t carry = 0;
-	for (size_t i = 0; i < a.data_.size(); ++i) {
-		uint32_t a_digit = a.data_[i];
-		uint32_t b_digit = i < b.data_.size() ? b.data_[i] : 0;
 
-		uint32_t curr_carry = carry;
-		uint64_t res_digit = a_digit - b_digit;
+	big_integer res;
+	res.data_.resize(std::max<size_t>(a.size(), 1));
+	uint32_t *res_data = res.data_.data();
+	uint32_t borrow = limb_kernels::get().sub_n(res_data, a.data(), b.data(), b.size());
+	limb_kernels::sub_1(res_data + b.size(), a.data() + b.size(), a.size() - b.size(), borrow);
 
-		if (b_digit > a_digit || res_digit < carry) {
-			carry = 1;
-		} else {
-			carry = 0;
-		}
+	res.sign_ = sign;
+	return res.trim();
+}
 
-		a.data_[i] = res_digit - curr_carry;
+big_integer operator*(big_integer_view a, big_integer_view b) {
+	big_integer::trace_scope scope;
+	scope.record(trace_op::multiply, a, b);
+	if (big_integer::pool_
+		&& std::min(a.size(), b.size()) >= big_integer::parallel_threshold_
+		&& std::max(a.size(), b.size()) >= 2 * big_integer::parallel_threshold_) {
+		return big_integer::parallel_multiply(a, b);
 	}
-	return a.trim();
-}
 
-big_integer operator*(big_integer const &a, big_integer const &b) {
 	big_integer res;
-	res.data_.resize(a.data_.size() + b.data_.size() + 1);
-
-	for (size_t i = 0; i < a.data_.size(); ++i) {
-		uint64_t carry = 0;
-		for (size_t j = 0; j < b.data_.size() || carry; ++j) {
-			uint32_t a_digit = i < a.data_.size() ? a.data_[i] : 0;
-			uint32_t b_digit = j < b.data_.size() ? b.data_[j] : 0;
-			uint64_t ans_digit = res.data_[i + j] + a_digit * 1ULL * b_digit + carry;
-
-			res.data_[i + j] = ans_digit & UINT32_MAX;
-			carry = ans_digit >> 32;
+	res.data_.resize(std::max<size_t>(a.size() + b.size(), 1));
+	if (a.size() < b.size()) {
+		std::swap(a, b);
+	}
+	if (b.size() > 0) {
+		// one pass over the longer operand per limb of the shorter one
+		limb_kernels const &kernels = limb_kernels::get();
+		uint32_t *res_data = res.data_.data();
+		res_data[a.size()] = kernels.mul_1(res_data, a.data(), a.size(), b[0]);
+		for (size_t i = 1; i < b.size(); ++i) {
+			res_data[i + a.size()] = kernels.addmul_1(res_data + i, a.data(), a.size(), b[i]);
 		}
 	}
 
-	res.sign_ = a.sign_ ^ b.sign_;
+	res.sign_ = a.is_negative() ^ b.is_negative();
 	return res.trim();
 }
 
+big_integer big_integer::parallel_multiply(big_integer_view a, big_integer_view b) {
+	big_integer_view longer = a.size() >= b.size() ? a : b;
+	big_integer_view shorter = a.size() >= b.size() ? b : a;
+	size_t half = longer.size() / 2;
+	big_integer_view low(longer.data(), half);
+	big_integer_view high(longer.data() + half, longer.size() - half);
+
+	big_integer low_product, high_product;
+	thread_pool::task_group group(*pool_);
+	group.run([&] {
+		trace_scope scope;
+		high_product = high * shorter;
+	});
+	low_product = low * shorter;
+	group.wait();
+
+	low_product.add_shifted(high_product, half);
+	low_product.sign_ = a.is_negative() ^ b.is_negative();
+	return low_product.trim();
+}
+
 /* * * * * * * * * Binary operators (div, mod) * * * * * * * * * */
 
 big_integer operator/(big_integer const &a, big_integer const &b) {
-	return big_integer::divide(a, b).first;
+	return big_integer_view(a) / big_integer_view(b);
 }
 
 big_integer operator%(big_integer const &a, big_integer const &b) {
-	return big_integer::divide(a, b).second;
+	return big_integer_view(a) % big_integer_view(b);
 }
 
-std::pair<big_integer, big_integer> big_integer::divide(big_integer const &u, big_integer const &v) {
-	big_integer a = u.sign_ ? -u : u, b = v.sign_ ? -v : v;
-	size_t res_sign = u.sign_ ^v.sign_;
+big_integer operator/(big_integer_view a, big_integer_view b) {
+	big_integer::trace_scope scope;
+	scope.record(trace_op::divide, a, b);
+	return big_integer::divide(a, b).first;
+}
 
-	if (a < b) {
-		return std::make_pair(0, u.sign_ == v.sign_ ? u : u + v);
+big_integer operator%(big_integer_view a, big_integer_view b) {
+	big_integer::trace_scope scope;
+	scope.record(trace_op::remainder, a, b);
+	return big_integer::divide(a, b).second;
+}
+
+/*
+ * Schoolbook division (Knuth, TAOCP vol. 2, 4.3.1, algorithm D). Both
+ * operands are shifted so that the divisor's top bit is set, which keeps
+ * every quotient limb estimate at most two above the real one.
+ */
+std::pair<big_integer, big_integer> big_integer::divide(big_integer_view u, big_integer_view v) {
+	if (compare_magnitude(u, v) < 0) {
+		return std::make_pair(0, big_integer(u));
 	}
 
-	if (b.data_.size() == 1) {
+	if (v.size() <= 1) {
 		return big_integer::divide_by_short(u, v);
 	}
+	// below this the products of the recursive division are too small to fork
+	if (pool_ && std::min(v.size(), u.size() - v.size()) >= 4 * parallel_threshold_) {
+		return big_integer::parallel_divide(u, v);
+	}
 
-	uint32_t shift = (static_cast<uint64_t>(UINT32_MAX) + 1) / (static_cast<uint64_t>(b.data_[b.data_.size() - 1]) + 1);
-	a *= shift;
-	b *= shift;
-	a.data_.push_back(0);
-	big_integer res;
-	res.sign_ = res_sign;
-	res.data_.resize(a.data_.size() - b.data_.size());
-
-	for (ptrdiff_t i = res.data_.size() - 1; i >= 0; --i) {
-		size_t sza = a.data_.size();
-		size_t szb = b.data_.size();
+	limb_kernels const &kernels = limb_kernels::get();
+	size_t n = v.size();
+	unsigned shift = __builtin_clz(v[n - 1]);
+
+	big_integer divisor, remainder;
+	divisor.data_.resize(n);
+	remainder.data_.resize(u.size() + 1);
+	uint32_t *d = divisor.data_.data();
+	uint32_t *r = remainder.data_.data();
+	if (shift) {
+		kernels.lshift(d, v.data(), n, shift);
+		r[u.size()] = kernels.lshift(r, u.data(), u.size(), shift);
+	} else {
+		std::copy(v.data(), v.data() + n, d);
+		std::copy(u.data(), u.data() + u.size(), r);
+	}
 
-		uint64_t lhs = static_cast<uint64_t>(a.data_[sza - 1]) << 32;
-		if (sza >= 2) {
-			lhs |= static_cast<uint64_t>(a.data_[sza - 2]);
+	big_integer res;
+	res.data_.resize(u.size() - n + 1);
+	uint32_t *res_data = res.data_.data();
+	for (size_t j = u.size() - n + 1; j-- > 0;) {
+		uint64_t top = (static_cast<uint64_t>(r[j + n]) << 32) | r[j + n - 1];
+		uint64_t estimate = top / d[n - 1];
+		uint64_t rest = top % d[n - 1];
+		while (estimate > UINT32_MAX || estimate * d[n - 2] > ((rest << 32) | r[j + n - 2])) {
+			--estimate;
+			rest += d[n - 1];
+			if (rest > UINT32_MAX) {
+				break;
+			}
 		}
-		uint32_t rhs = b.data_[szb - 1];
-
-		res.data_[i] = std::min(lhs / rhs, static_cast<uint64_t>(UINT32_MAX));
-		big_integer to_subtract = res.data_[i] * b;
 
-		while (a.shifted_less_than(to_subtract, i)) {
-			to_subtract -= b;
-			res.data_[i]--;
+		uint32_t borrow = kernels.submul_1(r + j, d, n, static_cast<uint32_t>(estimate));
+		if (r[j + n] < borrow) {
+			// the estimate was one too big, add the divisor back
+			--estimate;
+			r[j + n] += kernels.add_n(r + j, r + j, d, n);
 		}
-		a.shifted_subtract(to_subtract, i);
+		r[j + n] -= borrow;
+		res_data[j] = static_cast<uint32_t>(estimate);
 	}
 
-	a.sign_ = u.sign_;
-	return std::make_pair(res.trim(), a / shift);
+	if (shift) {
+		kernels.rshift(r, r, n, shift);
+	}
+	res.sign_ = u.is_negative() ^ v.is_negative();
+	remainder.sign_ = u.is_negative();
+	return std::make_pair(res.trim(), remainder.trim());
 }
 
-std::pair<big_integer, big_integer> big_integer::divide_by_short(big_integer const &a, big_integer const &other) {
-	uint32_t b = other.data_[0];
+std::pair<big_integer, big_integer> big_integer::divide_by_short(big_integer_view a, big_integer_view other) {
+	uint32_t b = other.size() > 0 ? other[0] : 0;
 	big_integer res;
-	res.data_.resize(a.data_.size());
-	uint64_t curr = 0;
-	for (ptrdiff_t i = res.data_.size() - 1; i >= 0; --i) {
-		curr = a.data_[i] + curr * static_cast<uint64_t>(UINT32_MAX + 1LL);
-		res.data_[i] = static_cast<uint32_t>(curr / b);
-		curr %= b;
-	}
-	res.sign_ = a.sign_ ^ other.sign_;
-	big_integer remainder = static_cast<uint32_t>(curr);
-	remainder.sign_ = a.sign_;
+	res.data_.resize(std::max<size_t>(a.size(), 1));
+	big_integer remainder = limb_kernels::get().divrem_1(res.data_.data(), a.data(), a.size(), b);
+	res.sign_ = a.is_negative() ^ other.is_negative();
+	remainder.sign_ = a.is_negative();
 	return std::make_pair(res.trim(), remainder.trim());
 }
 
-bool big_integer::shifted_less_than(big_integer const &rhs, size_t shift) {
-	if (rhs == 0) {
-		return false;
-	}
-	if (data_.size() != (rhs.data_.size() + shift)) {
-		return data_.size() < (rhs.data_.size() + shift);
+/*
+ * Recursive division (Burnikel and Ziegler; Brent and Zimmermann, Modern
+ * Computer Arithmetic, 1.4.3) for the parallel mode. It does about as much
+ * work as algorithm D, but half of it in multiplications, which fork.
+ */
+std::pair<big_integer, big_integer> big_integer::parallel_divide(big_integer_view u, big_integer_view v) {
+	unsigned shift = __builtin_clz(v[v.size() - 1]);
+	big_integer a = big_integer(u.magnitude()) << shift;
+	big_integer b = big_integer(v.magnitude()) << shift;
+	size_t n = b.data_.size();
+
+	big_integer quotient, remainder;
+	if (a.data_.size() < 2 * n) {
+		// a quotient shorter than the divisor depends on the top limbs of both, up to a few units too big
+		size_t low = 2 * n - a.data_.size();
+		quotient = recursive_divide(big_integer_view(a.data_.data() + low, a.data_.size() - low),
+									big_integer_view(b.data_.data() + low, n - low)).first;
+		remainder = a - quotient * b;
+		while (remainder.sign_) {
+			remainder = remainder + b;
+			--quotient;
+		}
 	} else {
-		for (ptrdiff_t i = rhs.data_.size() - 1; i >= 0; --i) {
-			if (data_[i + shift] != rhs.data_[i]) {
-				return data_[i + shift] < rhs.data_[i];
-			}
+		// as many quotient limbs at a time as the divisor has, from the top
+		size_t pos = a.data_.size() - n;
+		remainder = big_integer(big_integer_view(a.data_.data() + pos, n));
+		while (pos > 0) {
+			size_t step = std::min(pos, n);
+			pos -= step;
+			big_integer chunk(big_integer_view(a.data_.data() + pos, step));
+			chunk.add_shifted(remainder, step);
+			std::pair<big_integer, big_integer> part = recursive_divide(chunk, b);
+			quotient.add_shifted(part.first, pos);
+			remainder = std::move(part.second);
 		}
 	}
-	return false;
-}
-
-void big_integer::shifted_subtract(big_integer const &rhs, size_t shift) {
-	uint32_t carry = 0;
-	for (size_t i = shift; i < data_.size(); ++i) {
-		uint32_t a_digit = data_[i];
-		uint32_t b_digit = (i - shift < rhs.data_.size() ? rhs.data_[i - shift] : 0);
-
-		uint32_t curr_carry = carry;
-		uint64_t res_digit = a_digit - b_digit;
 
-		if (b_digit > a_digit || res_digit < carry) {
-			carry = 1;
-		} else {
-			carry = 0;
-		}
+	remainder >>= shift;
+	quotient.sign_ = u.is_negative() ^ v.is_negative();
+	remainder.sign_ = u.is_negative();
+	return std::make_pair(quotient.trim(), remainder.trim());
+}
 
-		data_[i] = res_digit - curr_carry;
+// b has its top bit set and a is at most twice as long
+std::pair<big_integer, big_integer> big_integer::recursive_divide(big_integer_view a, big_integer_view b) {
+	if (a.size() < b.size() + 4 * parallel_threshold_) {
+		return big_integer::divide(a, b);
 	}
 
-	trim();
+	// divides by the top of b, then takes the low k limbs of b off the remainder
+	size_t k = (a.size() - b.size()) / 2;
+	big_integer_view b_low(b.data(), k);
+	big_integer_view b_high(b.data() + k, b.size() - k);
+	auto take_low = [&](big_integer_view digits, std::pair<big_integer, big_integer> &part) {
+		big_integer res(digits);
+		res.add_shifted(part.second, k);
+		res -= part.first * b_low;
+		while (res.sign_) {
+			res = res + b;
+			--part.first;
+		}
+		return res;
+	};
+
+	big_integer_view a_high(a.data() + 2 * k, a.size() - 2 * k);
+	std::pair<big_integer, big_integer> high = recursive_divide(a_high, b_high);
+	big_integer middle = take_low(big_integer_view(a.data() + k, k), high);
+	std::pair<big_integer, big_integer> low = recursive_divide(middle, b_high);
+	big_integer remainder = take_low(big_integer_view(a.data(), k), low);
+	low.first.add_shifted(high.first, k);
+	return std::make_pair(std::move(low.first), std::move(remainder));
 }
 
 /* * * * * * * * * Bitwise binary operators (&, |, ^) * * * * * * * * * */
 
 big_integer operator&(big_integer const &a, big_integer const &b) {
+	big_integer::trace_scope scope;
+	scope.record(trace_op::bit_and, a, b);
 	return big_integer::bitwise_operator(a, b, [](uint32_t a, uint32_t b) { return a & b; });
 }
 
 big_integer operator|(big_integer const &a, big_integer const &b) {
+	big_integer::trace_scope scope;
+	scope.record(trace_op::bit_or, a, b);
 	return big_integer::bitwise_operator(a, b, [](uint32_t a, uint32_t b) { return a | b; });
 }
 
 big_integer operator^(big_integer const &a, big_integer const &b) {
+	big_integer::trace_scope scope;
+	scope.record(trace_op::bit_xor, a, b);
 	return big_integer::bitwise_operator(a, b, [](uint32_t a, uint32_t b) { return a ^ b; });
 }
 
-big_integer big_integer::convert_to_complementary(big_integer const &a) {
-	buffer res = a.data_;
-	for (size_t i = 0; i < res.size(); ++i) {
-		res[i] = ~res[i];
-	}
-	return big_integer(false, res) + 1;
-}
-
+// Works limb by limb on the two's complement forms, one limb wider than
+// the operands so that the last one holds only sign bits.
 big_integer big_integer::bitwise_operator(big_integer const &lhs,
 										  big_integer const &rhs,
 										  std::function<uint32_t(uint32_t, uint32_t)> f) {
-	big_integer a_complementary = lhs.sign_ ? convert_to_complementary(lhs) : lhs;
-	big_integer b_complementary = rhs.sign_ ? convert_to_complementary(rhs) : rhs;
-
+	size_t lhs_lowest = lhs.lowest_limb();
+	size_t rhs_lowest = rhs.lowest_limb();
 	big_integer res;
-	res.data_.resize(std::max(a_complementary.data_.size(), b_complementary.data_.size()));
-
+	res.data_.resize(std::max(lhs.data_.size(), rhs.data_.size()) + 1);
+	uint32_t *res_data = res.data_.data();
 	for (size_t i = 0; i < res.data_.size(); ++i) {
-		uint32_t a_digit = i < a_complementary.data_.size() ? a_complementary.data_[i] : (lhs.sign_ ? UINT32_MAX : 0);
-		uint32_t b_digit = i < b_complementary.data_.size() ? b_complementary.data_[i] : (rhs.sign_ ? UINT32_MAX : 0);
-		res.data_[i] = f(a_digit, b_digit);
+		res_data[i] = f(lhs.complement_limb(i, lhs_lowest), rhs.complement_limb(i, rhs_lowest));
 	}
 
-	res.sign_ = f(lhs.sign_, rhs.sign_);
-
+	res.sign_ = res_data[res.data_.size() - 1] >> 31;
 	if (res.sign_) {
-		res = convert_to_complementary(res);
-		res.sign_ = f(lhs.sign_, rhs.sign_);
+		for (size_t i = 0; i < res.data_.size(); ++i) {
+			res_data[i] = ~res_data[i];
+		}
+		limb_kernels::add_1(res_data, res_data, res.data_.size(), 1);
 	}
-
 	return res.trim();
 }
 
 /* * * * * * * * * Bit shift operators (>>, <<) * * * * * * * * * */
 
 big_integer operator<<(big_integer const &a, uint32_t b) {
-	uint32_t shift_digits = b / 32;
-	uint32_t shift_number = b % 32;
-
-	big_integer shifted = a * static_cast<uint32_t>(1 << shift_number);
+	big_integer_view value(a);
+	big_integer::trace_scope scope;
+	scope.record(trace_op::shift_left, value, b);
+	size_t shift_digits = b / 32;
+	unsigned shift_number = b % 32;
 
 	big_integer res;
-	res.sign_ = a.sign_;
-	res.data_.resize(shifted.data_.size() + shift_digits);
-	for (size_t i = 0; i < shift_digits; ++i) {
-		res.data_[i] = 0;
-	}
-	for (size_t i = 0; i < shifted.data_.size(); ++i) {
-		res.data_[i + shift_digits] = shifted.data_[i];
+	res.data_.resize(value.size() + shift_digits + 1);
+	uint32_t *res_data = res.data_.data();
+	if (shift_number) {
+		res_data[value.size() + shift_digits] =
+			limb_kernels::get().lshift(res_data + shift_digits, value.data(), value.size(), shift_number);
+	} else {
+		std::copy(value.data(), value.data() + value.size(), res_data + shift_digits);
 	}
-	return res;
+	res.sign_ = value.is_negative();
+	return res.trim();
 }
 
+// Rounds towards minus infinity, as the shift of a two's complement value would
 big_integer operator>>(big_integer const &a, uint32_t b) {
-	uint32_t shift_digits = b / 32;
-	uint32_t shift_number = b % 32;
-	uint32_t mod = 1 << shift_number;
+	big_integer_view value(a);
+	big_integer::trace_scope scope;
+	scope.record(trace_op::shift_right, value, b);
+	size_t shift_digits = b / 32;
+	unsigned shift_number = b % 32;
+	if (shift_digits >= value.size()) {
+		return value.is_negative() ? -1 : 0;
+	}
+
+	big_integer res;
+	size_t size = value.size() - shift_digits;
+	res.data_.resize(size + 1);
+	uint32_t *res_data = res.data_.data();
+	bool inexact = std::any_of(value.data(), value.data() + shift_digits, [](uint32_t digit) { return digit != 0; });
+	if (shift_number) {
+		inexact |= limb_kernels::get().rshift(res_data, value.data() + shift_digits, size, shift_number) != 0;
+	} else {
+		std::copy(value.data() + shift_digits, value.data() + value.size(), res_data);
+	}
+	if (value.is_negative() && inexact) {
+		limb_kernels::add_1(res_data, res_data, size + 1, 1);
+	}
+	res.sign_ = value.is_negative();
+	return res.trim();
+}
 
-	big_integer shifted = a / mod;
+/* * * * * * * * * Bit access * * * * * * * * * */
 
-	size_t shifted_length = shifted.data_.size() - shift_digits;
-	if (shifted_length <= 0) {
+size_t big_integer::bit_length() const {
+	size_t size = data_.size();
+	uint32_t top = data_[size - 1];
+	if (top == 0) {
 		return 0;
-	} else {
-		big_integer res;
-		res.sign_ = a.sign_;
-		res.data_.resize(shifted_length);
-		for (size_t i = 0; i < shifted_length; ++i) {
-			res.data_[i] = shifted.data_[i + shift_digits];
-		}
-		if (a.sign_) {
-			--res;
-		}
-		return res;
 	}
+	size_t length = 32 * size - __builtin_clz(top);
+	// -2^k takes one bit less than 2^k
+	if (sign_ && (top & (top - 1)) == 0 && lowest_limb() == size - 1) {
+		--length;
+	}
+	return length;
 }
 
-/* * * * * * * * * Сomparison operators * * * * * * * * * */
+size_t big_integer::popcount() const {
+	size_t count = limb_kernels::get().popcount(data_.data(), data_.size());
+	// |a| - 1 trades the lowest set bit for the zeros below it
+	return sign_ ? count - 1 + countr_zero() : count;
+}
 
-bool operator==(big_integer const &a, big_integer const &b) {
-	return (a.data_ == b.data_) && (a.sign_ == b.sign_);
+size_t big_integer::countr_zero() const {
+	size_t lowest = lowest_limb();
+	if (lowest == data_.size()) {
+		return SIZE_MAX;
+	}
+	return 32 * lowest + __builtin_ctz(data_[lowest]);
 }
 
-bool operator!=(big_integer const &a, big_integer const &b) {
-	return !(a == b);
+bool big_integer::test_bit(size_t pos) const {
+	return (complement_limb(pos / 32, lowest_limb()) >> (pos % 32)) & 1;
 }
 
-bool operator<(big_integer const &a, big_integer const &b) {
-	if (a.sign_ != b.sign_) {
-		return a.sign_ > b.sign_;
+/*
+ * A negative number has the bits of ~(|a| - 1), so its updates are the
+ * opposite ones applied to |a| - 1.
+ */
+big_integer &big_integer::set_bit(size_t pos) {
+	if (!sign_) {
+		set_magnitude_bit(pos, true);
+		return *this;
 	}
+	decrement_magnitude();
+	set_magnitude_bit(pos, false);
+	increment_magnitude();
+	return *this;
+}
 
-	if (a.sign_ == 1 && b.sign_ == 1) {
-		return (-a > -b);
+big_integer &big_integer::clear_bit(size_t pos) {
+	if (!sign_) {
+		set_magnitude_bit(pos, false);
+		return trim();
 	}
+	decrement_magnitude();
+	set_magnitude_bit(pos, true);
+	increment_magnitude();
+	return *this;
+}
 
-	if (a.data_.size() != b.data_.size()) {
-		return a.data_.size() < b.data_.size();
+big_integer &big_integer::flip_bit(size_t pos) {
+	if (!sign_) {
+		flip_magnitude_bit(pos);
+		return trim();
 	}
+	decrement_magnitude();
+	flip_magnitude_bit(pos);
+	increment_magnitude();
+	return *this;
+}
 
-	for (ptrdiff_t i = a.data_.size() - 1; i >= 0; i--) {
-		if (a.data_[i] != b.data_[i]) {
-			return a.data_[i] < b.data_[i];
+big_integer big_integer::extract_bits(size_t low, size_t length) const {
+	size_t lowest = lowest_limb();
+	size_t first = low / 32;
+	unsigned shift = low % 32;
+	big_integer res;
+	res.data_.resize(std::max<size_t>((length + 31) / 32, 1));
+	uint32_t *res_data = res.data_.data();
+	for (size_t i = 0; 32 * i < length; ++i) {
+		res_data[i] = complement_limb(first + i, lowest) >> shift;
+		if (shift) {
+			res_data[i] |= complement_limb(first + i + 1, lowest) << (32 - shift);
 		}
 	}
-	return false;
+	if (length % 32) {
+		res_data[length / 32] &= (UINT32_C(1) << (length % 32)) - 1;
+	}
+	return res.trim();
 }
 
-bool operator>(big_integer const &a, big_integer const &b) {
-	if (a.sign_ != b.sign_) {
-		return a.sign_ < b.sign_;
-	}
+/* * * * * * * * * Random numbers * * * * * * * * * */
 
-	if (a.sign_ == 1 && b.sign_ == 1) {
-		return (-a < -b);
+big_integer big_integer::random_bits(size_t bits, std::function<uint64_t()> const &next) {
+	size_t size = (bits + 31) / 32;
+	big_integer res;
+	res.data_.resize(std::max<size_t>(size, 1));
+	uint32_t *res_data = res.data_.data();
+	for (size_t i = 0; i < size; i += 2) {
+		uint64_t word = next();
+		res_data[i] = static_cast<uint32_t>(word);
+		if (i + 1 < size) {
+			res_data[i + 1] = static_cast<uint32_t>(word >> 32);
+		}
 	}
-
-	if (a.data_.size() != b.data_.size()) {
-		return a.data_.size() > b.data_.size();
+	if (bits % 32) {
+		res_data[size - 1] &= (UINT32_C(1) << (bits % 32)) - 1;
 	}
+	return res.trim();
+}
 
-	for (ptrdiff_t i = a.data_.size() - 1; i >= 0; i--) {
-		if (a.data_[i] != b.data_[i]) {
-			return a.data_[i] > b.data_[i];
+// Rejection sampling: every draw is below bound with probability over 1/2
+big_integer big_integer::random_below(big_integer const &bound, std::function<uint64_t()> const &next) {
+	if (bound <= 0) {
+		throw std::invalid_argument("big_integer: random bound must be positive");
+	}
+	size_t bits = bound.bit_length();
+	for (;;) {
+		big_integer res = random_bits(bits, next);
+		if (res < bound) {
+			return res;
 		}
 	}
-	return false;
+}
+
+/* * * * * * * * * Сomparison operators * * * * * * * * * */
+
+bool operator==(big_integer const &a, big_integer const &b) {
+	return big_integer_view(a) == big_integer_view(b);
+}
+
+bool operator!=(big_integer const &a, big_integer const &b) {
+	return !(a == b);
+}
+
+bool operator<(big_integer const &a, big_integer const &b) {
+	return big_integer_view(a) < big_integer_view(b);
+}
+
+bool operator>(big_integer const &a, big_integer const &b) {
+	return b < a;
 }
 
 bool operator<=(big_integer const &a, big_integer const &b) {
@@ -484,38 +806,428 @@ bool operator>=(big_integer const &a, big_integer const &b) {
 	return !(a < b);
 }
 
+bool operator==(big_integer_view a, big_integer_view b) {
+	big_integer::trace_scope scope;
+	scope.record(trace_op::equal, a, b);
+	if (a.is_negative() != b.is_negative() || a.size() != b.size()) {
+		return false;
+	}
+	return std::equal(a.data(), a.data() + a.size(), b.data());
+}
+
+bool operator!=(big_integer_view a, big_integer_view b) {
+	return !(a == b);
+}
+
+bool operator<(big_integer_view a, big_integer_view b) {
+	big_integer::trace_scope scope;
+	scope.record(trace_op::less, a, b);
+	if (a.is_negative() != b.is_negative()) {
+		return a.is_negative();
+	}
+	int cmp = big_integer::compare_magnitude(a, b);
+	return a.is_negative() ? cmp > 0 : cmp < 0;
+}
+
+bool operator>(big_integer_view a, big_integer_view b) {
+	return b < a;
+}
+
+bool operator<=(big_integer_view a, big_integer_view b) {
+	return !(b < a);
+}
+
+bool operator>=(big_integer_view a, big_integer_view b) {
+	return !(a < b);
+}
+
+/*
+ * this += rhs, or this -= rhs with negate, computed in this number's own
+ * limbs so that reserved capacity survives. rhs is viewed again after the
+ * resize, which keeps x += x correct.
+ */
+big_integer &big_integer::add_in_place(big_integer const &rhs, bool negate) {
+	big_integer_view value(*this);
+	big_integer_view other(rhs);
+	bool rhs_negative = other.is_negative() != negate;
+	bool same_sign = sign_ == rhs_negative;
+	int cmp = same_sign ? 0 : compare_magnitude(value, other);
+	size_t size = std::max(value.size(), other.size()) + 1;
+
+	data_.resize(size);
+	uint32_t *data = data_.data();
+	other = big_integer_view(rhs);
+	limb_kernels const &kernels = limb_kernels::get();
+	if (same_sign) {
+		uint32_t carry = kernels.add_n(data, data, other.data(), other.size());
+		limb_kernels::add_1(data + other.size(), data + other.size(), size - other.size(), carry);
+	} else if (cmp >= 0) {
+		uint32_t borrow = kernels.sub_n(data, data, other.data(), other.size());
+		limb_kernels::sub_1(data + other.size(), data + other.size(), size - other.size(), borrow);
+	} else {
+		// |rhs| is the larger, so the result fits in its limbs
+		kernels.sub_n(data, other.data(), data, other.size());
+		sign_ = rhs_negative;
+	}
+	return trim();
+}
+
+int big_integer::compare_magnitude(big_integer_view a, big_integer_view b) {
+	if (a.size() != b.size()) {
+		return a.size() < b.size() ? -1 : 1;
+	}
+	for (ptrdiff_t i = a.size() - 1; i >= 0; i--) {
+		if (a[i] != b[i]) {
+			return a[i] < b[i] ? -1 : 1;
+		}
+	}
+	return 0;
+}
+
 /* * * * * * * * * String related operation * * * * * * * * * */
 
 std::string to_string(big_integer const &a) {
-	if (a == 0) {
-		return "0";
+	return to_string(a, 10);
+}
+
+std::string to_string(big_integer const &a, unsigned base) {
+	check_base(base);
+	big_integer_view value(a);
+	big_integer::trace_scope scope;
+	scope.record(trace_op::to_string, value, base);
+	std::string res;
+	unsigned bits = power_of_two_bits(base);
+	if (bits) {
+		res.resize(big_integer::power_of_two_length(value, bits));
+		big_integer::power_of_two_digits(value, bits, digit_alphabet(base), res.size(), res.size(), &res[0]);
+	} else {
+		big_integer a_copy(value.magnitude());
+		if (a_copy.data_.size() > big_integer::DIGITS_CHUNK) {
+			std::vector<big_integer> powers = big_integer::digit_powers(base, a_copy.data_.size());
+			res = big_integer::split_to_digits(a_copy, base, powers, powers.size() - 1, 0);
+		} else {
+			res = big_integer::to_digits(a_copy, base, 0);
+		}
 	}
+	return value.is_negative() ? '-' + res : res;
+}
 
+std::string big_integer::to_digits(big_integer const &a, unsigned base, size_t width) {
+	std::pair<uint32_t, size_t> chunk = limb_chunk(base);
+	char const *alphabet = digit_alphabet(base);
+	limb_kernels const &kernels = limb_kernels::get();
 	big_integer a_copy(a);
+	uint32_t *data = a_copy.data_.data();
+	size_t size = big_integer_view(data, a_copy.data_.size()).size();
 	std::string res;
-	while (a_copy != 0) {
-		std::pair<big_integer, big_integer> digits = big_integer::divide_by_short(a_copy, 10);
-		res += static_cast<char>(digits.second.data_[0] + '0');
-		a_copy = digits.first;
+	while (size > 0) {
+		uint32_t value = kernels.divrem_1(data, data, size, chunk.first);
+		if (data[size - 1] == 0) {
+			--size;
+		}
+		for (size_t i = 0; i < chunk.second; ++i) {
+			res += alphabet[value % base];
+			value /= base;
+		}
+	}
+	while (!res.empty() && res.back() == alphabet[0]) {
+		res.pop_back();
 	}
-	if (a.sign_) res += '-';
+	res.resize(std::max(res.size(), std::max<size_t>(width, 1)), alphabet[0]);
 	reverse(res.begin(), res.end());
 	return res;
 }
 
-/* * * * * * * * * Helper functions * * * * * * * * * */
+/*
+ * Splits a by the largest power not above its square root and converts the
+ * halves separately, the low one padded to the power's digit count. Above
+ * the parallel threshold the low half is forked onto the pool.
+ */
+std::string big_integer::split_to_digits(big_integer const &a,
+										 unsigned base,
+										 std::vector<big_integer> const &powers,
+										 size_t k,
+										 size_t width) {
+	while (k > 0 && powers[k].data_.size() * 2 > a.data_.size() + 1) {
+		--k;
+	}
+	if (a.data_.size() <= DIGITS_CHUNK || powers[k] >= a) {
+		return to_digits(a, base, width);
+	}
 
-big_integer &big_integer::trim() {
-	while (data_.size() > 1) {
-		if (data_.back() == 0) {
-			data_.pop_back();
+	size_t low_width = limb_chunk(base).second << k;
+	size_t high_width = width > low_width ? width - low_width : 0;
+	std::pair<big_integer, big_integer> parts = divide(a, powers[k]);
+	std::string high, low;
+	if (pool_ && a.data_.size() >= parallel_threshold_) {
+		thread_pool::task_group group(*pool_);
+		group.run([&] {
+			trace_scope scope;
+			low = split_to_digits(parts.second, base, powers, k, low_width);
+		});
+		high = split_to_digits(parts.first, base, powers, k, high_width);
+		group.wait();
+	} else {
+		high = split_to_digits(parts.first, base, powers, k, high_width);
+		low = split_to_digits(parts.second, base, powers, k, low_width);
+	}
+	return high + low;
+}
+
+/*
+ * powers[k] is base^(digits * 2^k), where base^digits is the largest power
+ * that fits in a limb; the last one is just above half of the given size.
+ */
+std::vector<big_integer> big_integer::digit_powers(unsigned base, size_t limbs) {
+	std::vector<big_integer> powers(1, big_integer(limb_chunk(base).first));
+	while (powers.back().data_.size() * 2 <= limbs) {
+		powers.push_back(powers.back() * powers.back());
+	}
+	return powers;
+}
+
+size_t big_integer::power_of_two_length(big_integer_view a, unsigned bits) {
+	if (a.size() == 0) {
+		return 1;
+	}
+	size_t length = 32 * a.size() - __builtin_clz(a[a.size() - 1]);
+	return (length + bits - 1) / bits;
+}
+
+/*
+ * Writes count digits in base 2^bits, most significant first, the first one
+ * being digit top - 1. Hex digits of whole limbs are converted eight at a
+ * time inside a 64-bit register.
+ */
+void big_integer::power_of_two_digits(big_integer_view a,
+									  unsigned bits,
+									  char const *alphabet,
+									  size_t top,
+									  size_t count,
+									  char *out) {
+	uint32_t mask = (UINT32_C(1) << bits) - 1;
+	while (count > 0) {
+		if (bits == 4 && top % 8 == 0 && count >= 8) {
+			size_t i = top / 8 - 1;
+			uint64_t x = i < a.size() ? a[i] : 0;
+			x = (x | (x << 16)) & UINT64_C(0x0000FFFF0000FFFF);
+			x = (x | (x << 8)) & UINT64_C(0x00FF00FF00FF00FF);
+			x = (x | (x << 4)) & UINT64_C(0x0F0F0F0F0F0F0F0F);
+			uint64_t letters = ((x + UINT64_C(0x0606060606060606)) >> 4) & UINT64_C(0x0101010101010101);
+			x += UINT64_C(0x3030303030303030) + letters * static_cast<uint64_t>(alphabet[10] - '0' - 10);
+			if (little_endian_host) {
+				x = __builtin_bswap64(x);
+			}
+			std::memcpy(out, &x, sizeof(x));
+			out += 8;
+			top -= 8;
+			count -= 8;
 		} else {
-			break;
+			size_t bit = (top - 1) * bits;
+			size_t i = bit / 32;
+			size_t offset = bit % 32;
+			uint32_t digit = i < a.size() ? a[i] >> offset : 0;
+			if (offset + bits > 32 && i + 1 < a.size()) {
+				digit |= a[i + 1] << (32 - offset);
+			}
+			*out++ = alphabet[digit & mask];
+			--top;
+			--count;
+		}
+	}
+}
+
+/* * * * * * * * * Binary import & export * * * * * * * * * */
+
+namespace {
+void check_word_size(bits_format const &format) {
+	if (format.word_size == 0) {
+		throw std::invalid_argument("big_integer: word size must be positive");
+	}
+}
+
+// Offset in the external layout of the byte with significance pos
+size_t external_byte(size_t pos, size_t count, bits_format const &format) {
+	size_t word = pos / format.word_size;
+	size_t byte = pos % format.word_size;
+	if (format.word_order == endianness::big) {
+		word = count - 1 - word;
+	}
+	if (format.byte_order == endianness::big) {
+		byte = format.word_size - 1 - byte;
+	}
+	return word * format.word_size + byte;
+}
+
+// The layout is byte for byte the same as the limbs of a buffer
+bool is_native_layout(bits_format const &format) {
+	return little_endian_host
+		&& format.word_order == endianness::little
+		&& (format.byte_order == endianness::little || format.word_size == 1);
+}
+}
+
+big_integer big_integer::import_bits(void const *data, size_t count, bits_format const &format, bool negative) {
+	check_word_size(format);
+	trace_scope scope;
+	unsigned char const *bytes = static_cast<unsigned char const *>(data);
+	size_t length = count * format.word_size;
+
+	big_integer res;
+	res.data_.resize(length / 4 + 1);
+	uint32_t *limbs = res.data_.data();
+	if (is_native_layout(format)) {
+		if (length > 0) {
+			std::memcpy(limbs, bytes, length);
+		}
+	} else {
+		for (size_t pos = 0; pos < length; ++pos) {
+			limbs[pos / 4] |= static_cast<uint32_t>(bytes[external_byte(pos, count, format)]) << (pos % 4 * 8);
+		}
+	}
+
+	res.sign_ = negative;
+	if (format.encoding == sign_encoding::twos_complement) {
+		res.sign_ = length > 0 && (bytes[external_byte(length - 1, count, format)] & 0x80);
+		if (res.sign_) {
+			for (size_t pos = length; pos < res.data_.size() * 4; ++pos) {
+				limbs[pos / 4] |= UINT32_C(0xFF) << (pos % 4 * 8);
+			}
+			uint64_t carry = 1;
+			for (size_t i = 0; i < res.data_.size(); ++i) {
+				uint64_t digit = static_cast<uint64_t>(~limbs[i]) + carry;
+				limbs[i] = static_cast<uint32_t>(digit);
+				carry = digit >> 32;
+			}
+		}
+	}
+	res.trim();
+	scope.record(trace_op::import_bits, res, format.word_size);
+	return res;
+}
+
+size_t big_integer::export_bits(void *out, size_t count, bits_format const &format) const {
+	check_word_size(format);
+	big_integer_view value(*this);
+	trace_scope scope;
+	scope.record(trace_op::export_bits, value, format.word_size);
+	bool twos_complement = format.encoding == sign_encoding::twos_complement;
+	bool negative = twos_complement && value.is_negative();
+
+	size_t bits = 0;
+	if (value.size() > 0) {
+		uint32_t top = value[value.size() - 1];
+		bits = 32 * value.size() - __builtin_clz(top);
+		bool power_of_two = (top & (top - 1)) == 0
+			&& std::all_of(value.data(), value.data() + value.size() - 1, [](uint32_t limb) { return limb == 0; });
+		if (twos_complement && !(negative && power_of_two)) {
+			++bits;
+		}
+	}
+	size_t required = (bits + 8 * format.word_size - 1) / (8 * format.word_size);
+
+	unsigned char *bytes = static_cast<unsigned char *>(out);
+	size_t length = count * format.word_size;
+	if (length == 0) {
+		return required;
+	}
+	if (!negative && is_native_layout(format)) {
+		size_t copied = std::min(length, value.size() * 4);
+		std::memcpy(bytes, value.data(), copied);
+		std::memset(bytes + copied, 0, length - copied);
+		return required;
+	}
+
+	uint32_t limb = 0;
+	uint64_t carry = 1;
+	for (size_t pos = 0; pos < length; ++pos) {
+		if (pos % 4 == 0) {
+			size_t i = pos / 4;
+			limb = i < value.size() ? value[i] : 0;
+			if (negative) {
+				uint64_t digit = static_cast<uint64_t>(~limb) + carry;
+				limb = static_cast<uint32_t>(digit);
+				carry = digit >> 32;
+			}
+		}
+		bytes[external_byte(pos, count, format)] = static_cast<unsigned char>(limb >> (pos % 4 * 8));
+	}
+	return required;
+}
+
+/* * * * * * * * * Helper functions * * * * * * * * * */
+
+void big_integer::add_shifted(big_integer_view rhs, size_t shift) {
+	data_.resize(std::max(data_.size(), rhs.size() + shift) + 1);
+	uint32_t *data = data_.data() + shift;
+	uint32_t carry = limb_kernels::get().add_n(data, data, rhs.data(), rhs.size());
+	limb_kernels::add_1(data + rhs.size(), data + rhs.size(), data_.size() - shift - rhs.size(), carry);
+	trim();
+}
+
+// Index of the lowest non-zero limb, the size for zero
+size_t big_integer::lowest_limb() const {
+	uint32_t const *data = data_.data();
+	return std::find_if(data, data + data_.size(), [](uint32_t digit) { return digit != 0; }) - data;
+}
+
+// Limb pos of the two's complement form; lowest is lowest_limb()
+uint32_t big_integer::complement_limb(size_t pos, size_t lowest) const {
+	if (pos >= data_.size()) {
+		return sign_ ? UINT32_MAX : 0;
+	}
+	if (!sign_) {
+		return data_[pos];
+	}
+	if (pos < lowest) {
+		return 0;
+	}
+	return pos == lowest ? -data_[pos] : ~data_[pos];
+}
+
+void big_integer::set_magnitude_bit(size_t pos, bool value) {
+	if (pos / 32 >= data_.size()) {
+		if (!value) {
+			return;
 		}
+		data_.resize(pos / 32 + 1);
+	}
+	uint32_t &digit = data_.data()[pos / 32];
+	uint32_t mask = UINT32_C(1) << (pos % 32);
+	digit = value ? digit | mask : digit & ~mask;
+}
+
+void big_integer::flip_magnitude_bit(size_t pos) {
+	if (pos / 32 >= data_.size()) {
+		data_.resize(pos / 32 + 1);
 	}
-	if (data_.size() == 1 && data_.back() == 0) {
+	data_.data()[pos / 32] ^= UINT32_C(1) << (pos % 32);
+}
+
+// |a| - 1 for a non-zero a, keeps the limb count
+void big_integer::decrement_magnitude() {
+	uint32_t *data = data_.data();
+	limb_kernels::sub_1(data, data, data_.size(), 1);
+}
+
+void big_integer::increment_magnitude() {
+	uint32_t *data = data_.data();
+	if (limb_kernels::add_1(data, data, data_.size(), 1)) {
+		data_.push_back(1);
+	}
+	trim();
+}
+
+big_integer &big_integer::trim() {
+	uint32_t const *data = static_cast<buffer const &>(data_).data();
+	size_t size = data_.size();
+	while (size > 1 && data[size - 1] == 0) {
+		--size;
+	}
+	if (size == 1 && data[0] == 0) {
 		sign_ = false;
 	}
+	data_.truncate_to(size);
 
 	return *this;
 }
@@ -524,8 +1236,219 @@ uint32_t &big_integer::operator[](size_t pos) {
 	return data_[pos];
 }
 
-/* * * * * * * * * ostream operators * * * * * * * * * */
+uint32_t const &big_integer::operator[](size_t pos) const {
+	return data_[pos];
+}
+
+big_integer::operator big_integer_view() const {
+	return big_integer_view(data_.data(), data_.size(), sign_);
+}
+
+void big_integer::reserve(size_t limbs) {
+	data_.reserve(limbs);
+}
+
+size_t big_integer::capacity() const {
+	return data_.capacity();
+}
+
+/* * * * * * * * * Parallel execution * * * * * * * * * */
+
+std::unique_ptr<thread_pool> big_integer::pool_;
+size_t big_integer::parallel_threshold_ = 1024;
+
+void big_integer::set_thread_count(size_t threads) {
+	pool_.reset(threads > 1 ? new thread_pool(threads - 1) : nullptr);
+}
+
+size_t big_integer::thread_count() {
+	return pool_ ? pool_->size() + 1 : 1;
+}
+
+void big_integer::set_parallel_threshold(size_t limbs) {
+	parallel_threshold_ = std::max<size_t>(limbs, 1);
+}
+
+/* * * * * * * * * Tracing * * * * * * * * * */
+
+std::unique_ptr<trace_writer> big_integer::tracer_;
+thread_local size_t big_integer::trace_scope::depth = 0;
+
+void big_integer::start_trace(std::ostream &out, bool values) {
+	tracer_.reset(new trace_writer(out, values));
+}
+
+void big_integer::stop_trace() {
+	tracer_.reset();
+}
+
+/* * * * * * * * * Stream operators * * * * * * * * * */
 
 std::ostream &operator<<(std::ostream &s, big_integer const &a) {
-	return s << to_string(a);
+	std::ios_base::fmtflags base = s.flags() & std::ios_base::basefield;
+	big_integer::trace_scope scope;
+	scope.record(trace_op::write_text, a, stream_base(base));
+	big_integer_view value(a);
+	std::string prefix = stream_prefix(s.flags(), value);
+	if (s.width() != 0) {
+		// padding needs the whole text up front, internal padding goes after sign and prefix
+		std::ostringstream out;
+		out.flags(s.flags());
+		out << a;
+		std::string text = out.str();
+		size_t width = static_cast<size_t>(s.width());
+		s.width(0);
+		if (text.size() < width) {
+			std::ios_base::fmtflags adjust = s.flags() & std::ios_base::adjustfield;
+			// like the built-in integers, internal padding treats the octal 0 as a digit
+			size_t internal = prefix.size() - (!prefix.empty() && prefix.back() == '0');
+			size_t pos = adjust == std::ios_base::left ? text.size()
+												   : adjust == std::ios_base::internal ? internal : 0;
+			text.insert(pos, width - text.size(), s.fill());
+		}
+		return s.write(text.data(), text.size());
+	}
+
+	s.write(prefix.data(), prefix.size());
+	if (base == std::ios_base::hex) {
+		char const *alphabet = s.flags() & std::ios_base::uppercase ? UPPER_DIGITS : LOWER_DIGITS;
+		big_integer::write_power_of_two(s, value.magnitude(), 4, alphabet);
+	} else if (base == std::ios_base::oct) {
+		big_integer::write_power_of_two(s, value.magnitude(), 3, LOWER_DIGITS);
+	} else {
+		std::vector<big_integer> powers = big_integer::digit_powers(10, value.size());
+		big_integer::write_digits(s, value.magnitude(), 10, powers, powers.size() - 1, 0);
+	}
+	return s;
+}
+
+std::istream &operator>>(std::istream &s, big_integer &a) {
+	std::istream::sentry sentry(s);
+	if (!sentry) {
+		return s;
+	}
+	big_integer::trace_scope scope;
+
+	std::streambuf &in = *s.rdbuf();
+	bool negative = false;
+	int c = in.sgetc();
+	if (c == '-' || c == '+') {
+		negative = c == '-';
+		in.sbumpc();
+	}
+
+	big_integer res;
+	std::ios_base::fmtflags base = s.flags() & std::ios_base::basefield;
+	size_t digits = base == std::ios_base::hex ? res.read_hex(in)
+											   : res.read_digits(in, base == std::ios_base::oct ? 8 : 10);
+	if (in.sgetc() == std::char_traits<char>::eof()) {
+		s.setstate(std::ios_base::eofbit);
+	}
+	if (digits == 0) {
+		s.setstate(std::ios_base::failbit);
+		return s;
+	}
+
+	res.sign_ = negative;
+	a = res.trim();
+	scope.record(trace_op::read_text, a, stream_base(base));
+	return s;
+}
+
+/*
+ * Writes a in at most DIGITS_CHUNK-limb pieces: the high half is split off by
+ * the largest fitting power and written before the low half is converted.
+ */
+void big_integer::write_digits(std::ostream &s,
+							   big_integer_view a,
+							   unsigned base,
+							   std::vector<big_integer> const &powers,
+							   size_t k,
+							   size_t width) {
+	while (k > 0 && powers[k].data_.size() * 2 > a.size() + 1) {
+		--k;
+	}
+	if (a.size() <= DIGITS_CHUNK || powers[k] >= a) {
+		std::string digits = to_digits(big_integer(a), base, width);
+		s.write(digits.data(), digits.size());
+		return;
+	}
+
+	size_t low_width = limb_chunk(base).second << k;
+	std::pair<big_integer, big_integer> parts = divide(a, powers[k]);
+	write_digits(s, parts.first, base, powers, k, width > low_width ? width - low_width : 0);
+	parts.first = 0;
+	write_digits(s, parts.second, base, powers, k, low_width);
+}
+
+void big_integer::write_power_of_two(std::ostream &s, big_integer_view a, unsigned bits, char const *alphabet) {
+	char chunk[4096];
+	size_t top = power_of_two_length(a, bits);
+	while (top > 0) {
+		// after the first piece top stays a multiple of the chunk size
+		size_t count = top % sizeof(chunk) ? top % sizeof(chunk) : sizeof(chunk);
+		power_of_two_digits(a, bits, alphabet, top, count, chunk);
+		s.write(chunk, count);
+		top -= count;
+	}
+}
+
+size_t big_integer::read_digits(std::streambuf &in, unsigned base) {
+	std::pair<uint32_t, size_t> chunk = limb_chunk(base);
+	size_t digits = 0;
+	uint32_t value = 0;
+	uint32_t value_scale = 1;
+	for (int c = in.sgetc(), digit; (digit = digit_value(c, base)) >= 0; c = in.snextc()) {
+		value = value * base + digit;
+		value_scale *= base;
+		++digits;
+		if (value_scale == chunk.first) {
+			multiply_add(value_scale, value);
+			value = 0;
+			value_scale = 1;
+		}
+	}
+	if (value_scale > 1) {
+		multiply_add(value_scale, value);
+	}
+	return digits;
+}
+
+/*
+ * Digits arrive most significant first, so whole limbs are appended in that
+ * order, reversed once at the end and the leftover digits shifted in.
+ */
+size_t big_integer::read_hex(std::streambuf &in) {
+	size_t digits = 0;
+	uint32_t chunk = 0;
+	size_t chunk_digits = 0;
+	for (int c = in.sgetc(), value; (value = digit_value(c, 16)) >= 0; c = in.snextc()) {
+		chunk = (chunk << 4) | value;
+		++digits;
+		if (++chunk_digits == 8) {
+			data_.push_back(chunk);
+			chunk = 0;
+			chunk_digits = 0;
+		}
+	}
+
+	uint32_t *data = data_.data();
+	std::reverse(data, data + data_.size());
+	if (chunk_digits > 0) {
+		uint32_t shift = 4 * chunk_digits;
+		for (size_t i = data_.size() - 1; i > 0; --i) {
+			data[i] = (data[i] << shift) | (data[i - 1] >> (32 - shift));
+		}
+		data[0] = (data[0] << shift) | chunk;
+	}
+	return digits;
+}
+
+void big_integer::multiply_add(uint32_t multiplier, uint32_t addend) {
+	uint32_t *data = data_.data();
+	uint32_t carry = limb_kernels::get().mul_1(data, data, data_.size(), multiplier);
+	carry += limb_kernels::add_1(data, data, data_.size(), addend);
+	if (carry) {
+		data_.push_back(carry);
+	}
 }
@@ -9,7 +9,37 @@
 #include <iosfwd>
 #include <algorithm>
 #include <functional>
+#include <memory>
 #include "buffer.h"
+#include "big_integer_view.h"
+
+class thread_pool;
+class trace_writer;
+
+template<size_t Bits, bool Signed>
+class fixed_big_integer;
+
+enum class endianness {
+	little,
+	big
+};
+
+enum class sign_encoding {
+	sign_magnitude,
+	twos_complement
+};
+
+/*
+ * Layout of a binary number outside the library: words of word_size bytes,
+ * word_order tells where the most significant word is and byte_order does
+ * the same for the bytes inside a word.
+ */
+struct bits_format {
+	size_t word_size = 1;
+	endianness word_order = endianness::little;
+	endianness byte_order = endianness::little;
+	sign_encoding encoding = sign_encoding::sign_magnitude;
+};
 
 struct big_integer {
 	big_integer();
@@ -17,6 +47,14 @@ struct big_integer {
 	big_integer(uint32_t a);
 	big_integer(int a);
 	explicit big_integer(std::string const &str);
+
+	/*
+	 * Digits are 0-9a-z (either case) for bases 2 to 36 and the RFC 4648
+	 * alphabet for base 64, optionally preceded by a sign ('-' only in
+	 * base 64). Throws std::invalid_argument on a bad base or digit.
+	 */
+	big_integer(std::string const &str, unsigned base);
+	explicit big_integer(big_integer_view const &view);
 	~big_integer();
 	big_integer &operator=(big_integer const &other);
 
@@ -33,9 +71,9 @@ struct big_integer {
 	big_integer &operator<<=(uint32_t rhs);
 
 	big_integer &operator>>=(uint32_t rhs);
-	friend big_integer operator+(big_integer a, big_integer const &b);
+	friend big_integer operator+(big_integer const &a, big_integer const &b);
 
-	friend big_integer operator-(big_integer a, big_integer const &b);
+	friend big_integer operator-(big_integer const &a, big_integer const &b);
 	friend big_integer operator*(big_integer const &a, big_integer const &b);
 	friend big_integer operator/(big_integer const &a, big_integer const &b);
 	friend big_integer operator%(big_integer const &a, big_integer const &b);
@@ -46,6 +84,7 @@ struct big_integer {
 	friend big_integer operator<<(big_integer const &a, uint32_t b);
 
 	uint32_t &operator[](size_t pos);
+	uint32_t const &operator[](size_t pos) const;
 
 	friend big_integer operator>>(big_integer const &a, uint32_t b);
 	big_integer operator+() const;
@@ -66,30 +105,173 @@ struct big_integer {
 	friend bool operator<=(big_integer const &a, big_integer const &b);
 	friend bool operator>=(big_integer const &a, big_integer const &b);
 	friend std::string to_string(big_integer const &a);
+	friend std::string to_string(big_integer const &a, unsigned base);
+	friend std::ostream &operator<<(std::ostream &s, big_integer const &a);
+	friend std::istream &operator>>(std::istream &s, big_integer &a);
+	friend big_integer read_binary(std::istream &s);
+	friend void write_binary(std::ostream &s, big_integer_view a);
+
+	/*
+	 * The view reads this number's limbs in place and is invalidated by any
+	 * modification or destruction of it.
+	 */
+	operator big_integer_view() const;
+
+	friend big_integer operator+(big_integer_view a, big_integer_view b);
+	friend big_integer operator-(big_integer_view a, big_integer_view b);
+	friend big_integer operator*(big_integer_view a, big_integer_view b);
+	friend big_integer operator/(big_integer_view a, big_integer_view b);
+	friend big_integer operator%(big_integer_view a, big_integer_view b);
+	friend bool operator==(big_integer_view a, big_integer_view b);
+	friend bool operator<(big_integer_view a, big_integer_view b);
+
+	/*
+	 * Uniform random numbers whose limbs are filled straight from next,
+	 * which must return independent uniform 64-bit words (for example
+	 * std::ref to a std::mt19937_64). random_below throws
+	 * std::invalid_argument unless bound is positive.
+	 */
+	static big_integer random_bits(size_t bits, std::function<uint64_t()> const &next);
+	static big_integer random_below(big_integer const &bound, std::function<uint64_t()> const &next);
+
+	/*
+	 * Preallocates room for the given number of limbs. +=, -=, <<=, ++, --
+	 * and the bit updates work in place and do not reallocate while the
+	 * result fits; other operators build a new number, and assigning it
+	 * replaces this one's storage.
+	 */
+	void reserve(size_t limbs);
+	size_t capacity() const;
+
+	/*
+	 * Bits of a negative number are those of its two's complement, with
+	 * infinitely many leading ones, as for the bitwise operators. So
+	 * bit_length() leaves out the sign bit, popcount() of a negative
+	 * number counts its zero bits and countr_zero() of zero is SIZE_MAX.
+	 * Queries and in-place updates never allocate a temporary.
+	 */
+	size_t bit_length() const;
+	size_t popcount() const;
+	size_t countr_zero() const;
+	bool test_bit(size_t pos) const;
+	big_integer &set_bit(size_t pos);
+	big_integer &clear_bit(size_t pos);
+	big_integer &flip_bit(size_t pos);
+
+	// Bits [low, low + length) as a non-negative number
+	big_integer extract_bits(size_t low, size_t length) const;
+
+	/*
+	 * Builds a number from count words laid out as described by format. With
+	 * sign_magnitude the words hold |value| and negative gives the sign.
+	 * Both directions throw std::invalid_argument if word_size is zero.
+	 */
+	static big_integer import_bits(void const *data, size_t count, bits_format const &format, bool negative = false);
+
+	/*
+	 * Writes exactly count words (zero or sign extended) and returns how many
+	 * words the value needs; if that is more than count the output is
+	 * truncated. With sign_magnitude only |value| is written.
+	 */
+	size_t export_bits(void *out, size_t count, bits_format const &format) const;
+
+	/*
+	 * Parallel mode is off by default. With threads > 1, multiplication,
+	 * division and text conversion of operands above the threshold (in
+	 * limbs) fork their subproblems onto a shared work-stealing pool.
+	 * Division forks once the quotient and the divisor are both at least
+	 * four times the threshold. Results are the same as on the serial
+	 * path. Do not reconfigure while other threads are running big_integer
+	 * operations.
+	 */
+	static void set_thread_count(size_t threads);
+	static size_t thread_count();
+	static void set_parallel_threshold(size_t limbs);
+
+	/*
+	 * Tracing is off by default. While on, every arithmetic, bitwise,
+	 * shift and comparison operator, text conversion (to_string, the
+	 * string constructors and the stream operators), import_bits,
+	 * export_bits, read_binary and write_binary call appends a record of
+	 * its operands' signs and limb counts (and, with values, their limbs)
+	 * to out, in the format of big_integer_trace.h; the operations it runs
+	 * internally are not recorded. Unary operators, increments, bit access,
+	 * random numbers and mapped_big_integer are not traced. out must
+	 * outlive the trace. Do not start or stop tracing while other threads
+	 * are running big_integer operations.
+	 */
+	static void start_trace(std::ostream &out, bool values = false);
+	static void stop_trace();
 
  private:
+	template<size_t Bits, bool Signed>
+	friend class fixed_big_integer;
+
 	big_integer(bool sign, buffer &data);
 	big_integer(bool sign, std::vector<uint32_t> &data);
 
 	bool sign_;
 	buffer data_;
 
-	static std::pair<big_integer, big_integer> divide(big_integer const &a, big_integer const &b);
-	static std::pair<big_integer, big_integer> divide_by_short(big_integer const &a, big_integer const &b);
-	bool shifted_less_than(big_integer const &rhs, size_t shift);
-	void shifted_subtract(big_integer const &rhs, size_t shift);
+	static std::unique_ptr<thread_pool> pool_;
+	static size_t parallel_threshold_;
+	static std::unique_ptr<trace_writer> tracer_;
+
+	struct trace_scope;
+
+	// text conversion splits numbers down to this many limbs, then divides by a short power
+	static size_t constexpr DIGITS_CHUNK = 256;
+
+	void add_shifted(big_integer_view rhs, size_t shift);
+	big_integer &add_in_place(big_integer const &rhs, bool negate);
+	static big_integer parallel_multiply(big_integer_view a, big_integer_view b);
+	static std::string to_digits(big_integer const &a, unsigned base, size_t width);
+	static std::string split_to_digits(big_integer const &a,
+									   unsigned base,
+									   std::vector<big_integer> const &powers,
+									   size_t k,
+									   size_t width);
+	static std::vector<big_integer> digit_powers(unsigned base, size_t limbs);
+	static void write_digits(std::ostream &s,
+							 big_integer_view a,
+							 unsigned base,
+							 std::vector<big_integer> const &powers,
+							 size_t k,
+							 size_t width);
+	static size_t power_of_two_length(big_integer_view a, unsigned bits);
+	static void power_of_two_digits(big_integer_view a,
+									unsigned bits,
+									char const *alphabet,
+									size_t top,
+									size_t count,
+									char *out);
+	static void write_power_of_two(std::ostream &s, big_integer_view a, unsigned bits, char const *alphabet);
+	size_t read_digits(std::streambuf &in, unsigned base);
+	size_t read_hex(std::streambuf &in);
+	void multiply_add(uint32_t multiplier, uint32_t addend);
+
+	static int compare_magnitude(big_integer_view a, big_integer_view b);
+	static std::pair<big_integer, big_integer> divide(big_integer_view a, big_integer_view b);
+	static std::pair<big_integer, big_integer> divide_by_short(big_integer_view a, big_integer_view b);
+	static std::pair<big_integer, big_integer> parallel_divide(big_integer_view a, big_integer_view b);
+	static std::pair<big_integer, big_integer> recursive_divide(big_integer_view a, big_integer_view b);
 
 	big_integer &trim();
 
-	static big_integer convert_to_complementary(big_integer const &a);
+	size_t lowest_limb() const;
+	uint32_t complement_limb(size_t pos, size_t lowest) const;
+	void set_magnitude_bit(size_t pos, bool value);
+	void flip_magnitude_bit(size_t pos);
+	void decrement_magnitude();
+	void increment_magnitude();
 
 	static big_integer bitwise_operator(big_integer const &lhs,
 										big_integer const &rhs,
 										std::function<uint32_t(uint32_t, uint32_t)> f);
 };
 
-big_integer operator+(big_integer a, big_integer const &b);
-big_integer operator-(big_integer a, big_integer const &b);
+big_integer operator+(big_integer const &a, big_integer const &b);
+big_integer operator-(big_integer const &a, big_integer const &b);
 big_integer operator*(big_integer const &a, big_integer const &b);
 big_integer operator/(big_integer const &a, big_integer const &b);
 big_integer operator%(big_integer const &a, big_integer const &b);
@@ -108,7 +290,22 @@ bool operator>(big_integer const &a, big_integer const &b);
 bool operator<=(big_integer const &a, big_integer const &b);
 bool operator>=(big_integer const &a, big_integer const &b);
 
+big_integer operator+(big_integer_view a, big_integer_view b);
+big_integer operator-(big_integer_view a, big_integer_view b);
+big_integer operator*(big_integer_view a, big_integer_view b);
+big_integer operator/(big_integer_view a, big_integer_view b);
+big_integer operator%(big_integer_view a, big_integer_view b);
+
+bool operator==(big_integer_view a, big_integer_view b);
+bool operator!=(big_integer_view a, big_integer_view b);
+bool operator<(big_integer_view a, big_integer_view b);
+bool operator>(big_integer_view a, big_integer_view b);
+bool operator<=(big_integer_view a, big_integer_view b);
+bool operator>=(big_integer_view a, big_integer_view b);
+
 std::string to_string(big_integer const &a);
+std::string to_string(big_integer const &a, unsigned base);
 std::ostream &operator<<(std::ostream &s, big_integer const &a);
+std::istream &operator>>(std::istream &s, big_integer &a);
 
 #endif // BIG_INTEGER_H
@@ -0,0 +1,201 @@
+#include "big_integer_io.h"
+#include "host_endian.h"
+#include "big_integer_trace.h"
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <system_error>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+char const MAGIC[4] = {'B', 'I', 'G', 'I'};
+size_t constexpr HEADER_SIZE = 16;
+uint32_t constexpr NEGATIVE_FLAG = 1;
+// limbs read at a time, so a forged count cannot allocate past the data
+size_t constexpr READ_CHUNK = 1 << 16;
+
+void store_le(unsigned char *out, uint64_t value, size_t bytes) {
+	for (size_t i = 0; i < bytes; ++i) {
+		out[i] = static_cast<unsigned char>(value >> (8 * i));
+	}
+}
+
+uint64_t load_le(unsigned char const *in, size_t bytes) {
+	uint64_t value = 0;
+	for (size_t i = 0; i < bytes; ++i) {
+		value |= static_cast<uint64_t>(in[i]) << (8 * i);
+	}
+	return value;
+}
+
+void check_header(unsigned char const *header, uint64_t &size, bool &negative) {
+	if (std::memcmp(header, MAGIC, sizeof(MAGIC)) != 0) {
+		throw std::runtime_error("big_integer: not a binary big_integer");
+	}
+	negative = load_le(header + 4, 4) & NEGATIVE_FLAG;
+	size = load_le(header + 8, 8);
+}
+}
+
+/* * * * * * * * * fd_streambuf * * * * * * * * * */
+
+fd_streambuf::fd_streambuf(int fd) : fd_(fd) {
+	setg(input_, input_, input_);
+	setp(output_, output_ + BUFFER_SIZE);
+}
+
+fd_streambuf::~fd_streambuf() {
+	flush_output();
+}
+
+bool fd_streambuf::flush_output() {
+	char *begin = pbase();
+	while (begin < pptr()) {
+		ssize_t written = ::write(fd_, begin, pptr() - begin);
+		if (written < 0 && errno == EINTR) {
+			continue;
+		}
+		if (written <= 0) {
+			return false;
+		}
+		begin += written;
+	}
+	setp(output_, output_ + BUFFER_SIZE);
+	return true;
+}
+
+fd_streambuf::int_type fd_streambuf::underflow() {
+	ssize_t length;
+	do {
+		length = ::read(fd_, input_, BUFFER_SIZE);
+	} while (length < 0 && errno == EINTR);
+	if (length <= 0) {
+		return traits_type::eof();
+	}
+	setg(input_, input_, input_ + length);
+	return traits_type::to_int_type(*gptr());
+}
+
+fd_streambuf::int_type fd_streambuf::overflow(int_type c) {
+	if (!flush_output()) {
+		return traits_type::eof();
+	}
+	if (!traits_type::eq_int_type(c, traits_type::eof())) {
+		*pptr() = traits_type::to_char_type(c);
+		pbump(1);
+	}
+	return traits_type::not_eof(c);
+}
+
+int fd_streambuf::sync() {
+	return flush_output() ? 0 : -1;
+}
+
+/* * * * * * * * * Binary format * * * * * * * * * */
+
+void write_binary(std::ostream &s, big_integer_view a) {
+	big_integer::trace_scope scope;
+	scope.record(trace_op::write_binary, a, 0);
+	unsigned char header[HEADER_SIZE];
+	std::memcpy(header, MAGIC, sizeof(MAGIC));
+	store_le(header + 4, a.is_negative() ? NEGATIVE_FLAG : 0, 4);
+	store_le(header + 8, a.size(), 8);
+	s.write(reinterpret_cast<char const *>(header), HEADER_SIZE);
+
+	if (little_endian_host) {
+		s.write(reinterpret_cast<char const *>(a.data()), a.size() * sizeof(uint32_t));
+		return;
+	}
+	unsigned char limb[sizeof(uint32_t)];
+	for (size_t i = 0; i < a.size(); ++i) {
+		store_le(limb, a[i], sizeof(limb));
+		s.write(reinterpret_cast<char const *>(limb), sizeof(limb));
+	}
+}
+
+big_integer read_binary(std::istream &s) {
+	unsigned char header[HEADER_SIZE];
+	if (!s.read(reinterpret_cast<char *>(header), HEADER_SIZE)) {
+		throw std::runtime_error("big_integer: truncated binary header");
+	}
+	uint64_t size;
+	bool negative;
+	check_header(header, size, negative);
+	big_integer::trace_scope scope;
+
+	big_integer res;
+	for (uint64_t done = 0; done < size;) {
+		size_t count = static_cast<size_t>(std::min<uint64_t>(size - done, READ_CHUNK));
+		res.data_.resize(done + count);
+		uint32_t *limbs = res.data_.data() + done;
+		if (!s.read(reinterpret_cast<char *>(limbs), count * sizeof(uint32_t))) {
+			throw std::runtime_error("big_integer: truncated binary limbs");
+		}
+		if (!little_endian_host) {
+			for (size_t i = 0; i < count; ++i) {
+				limbs[i] = static_cast<uint32_t>(load_le(reinterpret_cast<unsigned char const *>(limbs + i), sizeof(uint32_t)));
+			}
+		}
+		done += count;
+	}
+	res.sign_ = negative;
+	res.trim();
+	scope.record(trace_op::read_binary, res, 0);
+	return res;
+}
+
+/* * * * * * * * * mapped_big_integer * * * * * * * * * */
+
+mapped_big_integer::mapped_big_integer(std::string const &path)
+	: address_(nullptr), length_(0), view_(nullptr, 0) {
+	if (!little_endian_host) {
+		throw std::runtime_error("big_integer: mapping needs a little-endian host");
+	}
+
+	int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0) {
+		throw std::system_error(errno, std::generic_category(), "big_integer: open " + path);
+	}
+	struct stat info;
+	if (::fstat(fd, &info) != 0) {
+		int error = errno;
+		::close(fd);
+		throw std::system_error(error, std::generic_category(), "big_integer: stat " + path);
+	}
+	length_ = static_cast<size_t>(info.st_size);
+	if (length_ < HEADER_SIZE) {
+		::close(fd);
+		throw std::runtime_error("big_integer: truncated binary header in " + path);
+	}
+	address_ = ::mmap(nullptr, length_, PROT_READ, MAP_PRIVATE, fd, 0);
+	int error = errno;
+	::close(fd);
+	if (address_ == MAP_FAILED) {
+		address_ = nullptr;
+		throw std::system_error(error, std::generic_category(), "big_integer: mmap " + path);
+	}
+
+	unsigned char const *bytes = static_cast<unsigned char const *>(address_);
+	uint64_t size;
+	bool negative;
+	try {
+		check_header(bytes, size, negative);
+		if (size > (length_ - HEADER_SIZE) / sizeof(uint32_t)) {
+			throw std::runtime_error("big_integer: truncated binary limbs in " + path);
+		}
+	} catch (...) {
+		::munmap(address_, length_);
+		throw;
+	}
+	view_ = big_integer_view(reinterpret_cast<uint32_t const *>(bytes + HEADER_SIZE), size, negative);
+}
+
+mapped_big_integer::~mapped_big_integer() {
+	if (address_) {
+		::munmap(address_, length_);
+	}
+}
@@ -0,0 +1,76 @@
+#ifndef BIGINT__BIG_INTEGER_IO_H_
+#define BIGINT__BIG_INTEGER_IO_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <streambuf>
+#include <string>
+#include "big_integer.h"
+
+/*
+ * Buffered streambuf over a POSIX file descriptor, so the incremental
+ * operator<< and operator>> of big_integer can run on pipes and sockets.
+ * The descriptor is not closed by the buffer.
+ */
+class fd_streambuf : public std::streambuf {
+	static size_t constexpr BUFFER_SIZE = 1 << 16;
+
+	int fd_;
+	char input_[BUFFER_SIZE];
+	char output_[BUFFER_SIZE];
+
+	bool flush_output();
+
+ protected:
+	int_type underflow() override;
+	int_type overflow(int_type c) override;
+	int sync() override;
+
+ public:
+	explicit fd_streambuf(int fd);
+	~fd_streambuf() override;
+
+	fd_streambuf(fd_streambuf const &other) = delete;
+	fd_streambuf &operator=(fd_streambuf const &other) = delete;
+};
+
+/*
+ * Binary format: the magic "BIGI", a 32-bit flags word (bit 0 is the sign),
+ * a 64-bit limb count and then the 32-bit limbs, least significant first.
+ * Everything is little-endian and the limbs start at offset 16, so a mapped
+ * file can be used as a big_integer_view without copying. read_binary grows
+ * the number only as limbs arrive, so a corrupt count fails on the truncated
+ * data instead of allocating what it claims.
+ */
+void write_binary(std::ostream &s, big_integer_view a);
+big_integer read_binary(std::istream &s);
+
+/*
+ * A number stored in the binary format above, mapped read-only into memory.
+ * Needs a little-endian host. Throws std::system_error if the file cannot be
+ * mapped and std::runtime_error if it is not in the binary format.
+ */
+class mapped_big_integer {
+	void *address_;
+	size_t length_;
+	big_integer_view view_;
+
+ public:
+	explicit mapped_big_integer(std::string const &path);
+	~mapped_big_integer();
+
+	mapped_big_integer(mapped_big_integer const &other) = delete;
+	mapped_big_integer &operator=(mapped_big_integer const &other) = delete;
+
+	big_integer_view view() const {
+		return view_;
+	}
+
+	operator big_integer_view() const {
+		return view_;
+	}
+};
+
+#endif //BIGINT__BIG_INTEGER_IO_H_
@@ -0,0 +1,454 @@
+#include "big_integer_prime.h"
+#include "limb_kernels.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace {
+
+typedef std::vector<uint32_t> limbs;
+
+uint32_t constexpr SMALL_PRIME_LIMIT = 4096;
+
+// Non-negative x < 2^(32 * size) as exactly size limbs
+limbs to_limbs(big_integer const &x, size_t size) {
+	big_integer_view view(x);
+	limbs res(size);
+	std::copy(view.data(), view.data() + view.size(), res.begin());
+	return res;
+}
+
+int compare_limbs(uint32_t const *a, uint32_t const *b, size_t size) {
+	for (size_t i = size; i-- > 0;) {
+		if (a[i] != b[i]) {
+			return a[i] < b[i] ? -1 : 1;
+		}
+	}
+	return 0;
+}
+
+/* * * * * * * * * Trial division * * * * * * * * * */
+
+/*
+ * The odd primes below SMALL_PRIME_LIMIT, in groups whose products fit in a
+ * limb, and the product of all of them. A number is first reduced modulo
+ * the whole product, so the pass per group costs the same however long the
+ * number is.
+ */
+struct small_primes {
+	std::vector<uint32_t> primes;
+	std::vector<uint32_t> group_products;
+	std::vector<size_t> group_ends;
+	big_integer product;
+
+	small_primes() : product(1) {
+		std::vector<bool> composite(SMALL_PRIME_LIMIT);
+		for (uint32_t p = 3; p < SMALL_PRIME_LIMIT; p += 2) {
+			if (!composite[p]) {
+				primes.push_back(p);
+				for (uint32_t q = p * p; q < SMALL_PRIME_LIMIT; q += 2 * p) {
+					composite[q] = true;
+				}
+			}
+		}
+
+		uint64_t group = 1;
+		for (size_t i = 0; i < primes.size(); ++i) {
+			if (group * primes[i] > UINT32_MAX) {
+				group_products.push_back(static_cast<uint32_t>(group));
+				group_ends.push_back(i);
+				group = 1;
+			}
+			group *= primes[i];
+		}
+		group_products.push_back(static_cast<uint32_t>(group));
+		group_ends.push_back(primes.size());
+
+		for (uint32_t group_product : group_products) {
+			product *= group_product;
+		}
+	}
+
+	// n mod p for every prime p, n non-negative
+	std::vector<uint32_t> residues(big_integer const &n) const {
+		big_integer reduced = n < product ? n : n % product;
+		big_integer_view view(reduced);
+		limbs quotient(view.size());
+		limb_kernels const &kernels = limb_kernels::get();
+
+		std::vector<uint32_t> res(primes.size());
+		size_t i = 0;
+		for (size_t group = 0; group < group_products.size(); ++group) {
+			uint32_t remainder = kernels.divrem_1(quotient.data(), view.data(), view.size(), group_products[group]);
+			for (; i < group_ends[group]; ++i) {
+				res[i] = remainder % primes[i];
+			}
+		}
+		return res;
+	}
+};
+
+small_primes const &get_small_primes() {
+	static small_primes const tables;
+	return tables;
+}
+
+/* * * * * * * * * Montgomery arithmetic * * * * * * * * * */
+
+/*
+ * Arithmetic modulo an odd m > 1 of n limbs on numbers in Montgomery form
+ * a * R mod m, R = 2^(32n), kept as exactly n limbs. Products are reduced
+ * limb by limb (REDC), so no division happens after the conversion in.
+ */
+class montgomery {
+	limb_kernels const &kernels_;
+	big_integer modulus_;
+	limbs m_;
+	size_t n_;
+	uint32_t inverse_;
+	limbs product_;
+	limbs squares_;
+
+	// r = product_ / R mod m
+	void reduce(limbs &r) {
+		uint32_t *t = product_.data();
+		for (size_t i = 0; i < n_; ++i) {
+			uint32_t carry = kernels_.addmul_1(t + i, m_.data(), n_, t[i] * inverse_);
+			limb_kernels::add_1(t + i + n_, t + i + n_, n_ + 1 - i, carry);
+		}
+		if (t[2 * n_] || compare_limbs(t + n_, m_.data(), n_) >= 0) {
+			kernels_.sub_n(r.data(), t + n_, m_.data(), n_);
+		} else {
+			std::copy(t + n_, t + 2 * n_, r.begin());
+		}
+	}
+
+ public:
+	explicit montgomery(big_integer const &modulus)
+		: kernels_(limb_kernels::get()),
+		  modulus_(modulus),
+		  m_(to_limbs(modulus, big_integer_view(modulus).size())),
+		  n_(m_.size()),
+		  product_(2 * n_ + 1),
+		  squares_(2 * n_) {
+		// Newton's iteration for 1 / m mod 2^32, m * m = 1 mod 8 to start
+		uint32_t x = m_[0];
+		for (int i = 0; i < 4; ++i) {
+			x *= 2 - m_[0] * x;
+		}
+		inverse_ = -x;
+	}
+
+	limbs to_form(big_integer const &x) const {
+		big_integer reduced = x % modulus_;
+		if (reduced < 0) {
+			reduced += modulus_;
+		}
+		return to_limbs((reduced << static_cast<uint32_t>(32 * n_)) % modulus_, n_);
+	}
+
+	limbs zero() const {
+		return limbs(n_);
+	}
+
+	limbs one() const {
+		return to_form(1);
+	}
+
+	void multiply(limbs &r, limbs const &a, limbs const &b) {
+		uint32_t *t = product_.data();
+		t[n_] = kernels_.mul_1(t, a.data(), n_, b[0]);
+		for (size_t i = 1; i < n_; ++i) {
+			t[n_ + i] = kernels_.addmul_1(t + i, a.data(), n_, b[i]);
+		}
+		t[2 * n_] = 0;
+		reduce(r);
+	}
+
+	// Each cross product once, doubled, then the squares of the limbs added
+	void square(limbs &r, limbs const &a) {
+		uint32_t *t = product_.data();
+		std::fill(product_.begin(), product_.end(), 0);
+		for (size_t i = 0; i + 1 < n_; ++i) {
+			t[i + n_] = kernels_.addmul_1(t + 2 * i + 1, a.data() + i + 1, n_ - i - 1, a[i]);
+		}
+		t[2 * n_] = kernels_.lshift(t, t, 2 * n_, 1);
+		for (size_t i = 0; i < n_; ++i) {
+			uint64_t square = static_cast<uint64_t>(a[i]) * a[i];
+			squares_[2 * i] = static_cast<uint32_t>(square);
+			squares_[2 * i + 1] = static_cast<uint32_t>(square >> 32);
+		}
+		t[2 * n_] += kernels_.add_n(t, t, squares_.data(), 2 * n_);
+		reduce(r);
+	}
+
+	void add(limbs &r, limbs const &a, limbs const &b) const {
+		uint32_t carry = kernels_.add_n(r.data(), a.data(), b.data(), n_);
+		if (carry || compare_limbs(r.data(), m_.data(), n_) >= 0) {
+			kernels_.sub_n(r.data(), r.data(), m_.data(), n_);
+		}
+	}
+
+	void subtract(limbs &r, limbs const &a, limbs const &b) const {
+		if (kernels_.sub_n(r.data(), a.data(), b.data(), n_)) {
+			kernels_.add_n(r.data(), r.data(), m_.data(), n_);
+		}
+	}
+
+	// r / 2 mod m, which is the same in Montgomery form
+	void halve(limbs &r) const {
+		uint32_t carry = r[0] & 1 ? kernels_.add_n(r.data(), r.data(), m_.data(), n_) : 0;
+		kernels_.rshift(r.data(), r.data(), n_, 1);
+		r[n_ - 1] |= carry << 31;
+	}
+
+	// Left to right with a fixed 4-bit window
+	limbs power(limbs const &base, big_integer const &exponent) {
+		std::vector<limbs> table(16, limbs(n_));
+		table[0] = one();
+		table[1] = base;
+		for (size_t i = 2; i < table.size(); ++i) {
+			multiply(table[i], table[i - 1], base);
+		}
+
+		big_integer_view bits(exponent);
+		limbs res = table[0];
+		for (size_t window = bits.size() * 8; window-- > 0;) {
+			if (res != table[0]) {
+				for (int i = 0; i < 4; ++i) {
+					square(res, res);
+				}
+			}
+			uint32_t digit = (bits[window / 8] >> (4 * (window % 8))) & 0xF;
+			if (digit) {
+				multiply(res, res, table[digit]);
+			}
+		}
+		return res;
+	}
+};
+
+/* * * * * * * * * Probable prime tests * * * * * * * * * */
+
+// Jacobi symbol (a / n) for odd n
+int small_jacobi(uint64_t a, uint64_t n) {
+	int res = 1;
+	a %= n;
+	while (a != 0) {
+		while (a % 2 == 0) {
+			a /= 2;
+			if (n % 8 == 3 || n % 8 == 5) {
+				res = -res;
+			}
+		}
+		std::swap(a, n);
+		if (a % 4 == 3 && n % 4 == 3) {
+			res = -res;
+		}
+		a %= n;
+	}
+	return n == 1 ? res : 0;
+}
+
+// (d / n) for odd n > |d| by reciprocity, d odd
+int jacobi(int64_t d, big_integer const &n) {
+	int res = 1;
+	uint32_t low = big_integer_view(n)[0];
+	uint64_t a = d < 0 ? -d : d;
+	if (d < 0 && low % 4 == 3) {
+		res = -res;
+	}
+	if (a % 4 == 3 && low % 4 == 3) {
+		res = -res;
+	}
+	big_integer remainder = n % big_integer(static_cast<uint32_t>(a));
+	return res * small_jacobi(remainder[0], a);
+}
+
+bool is_square(big_integer const &n) {
+	big_integer root = big_integer(1) << static_cast<uint32_t>((n.bit_length() + 1) / 2);
+	for (;;) {
+		big_integer next = (root + n / root) >> 1;
+		if (next >= root) {
+			return root * root == n;
+		}
+		root = next;
+	}
+}
+
+bool miller_rabin(montgomery &field, big_integer const &n, big_integer const &base) {
+	big_integer n_minus_one = n - 1;
+	size_t s = n_minus_one.countr_zero();
+	limbs one = field.one();
+	limbs minus_one = field.to_form(n_minus_one);
+
+	limbs x = field.power(field.to_form(base), n_minus_one >> static_cast<uint32_t>(s));
+	if (x == one || x == minus_one) {
+		return true;
+	}
+	for (size_t r = 1; r < s; ++r) {
+		field.square(x, x);
+		if (x == minus_one) {
+			return true;
+		}
+		if (x == one) {
+			return false;
+		}
+	}
+	return false;
+}
+
+/*
+ * Strong Lucas test with P = 1, Q = (1 - D) / 4 and D the first of 5, -7,
+ * 9, -11, ... with (D / n) = -1. U and V are doubled and stepped through
+ * the bits of the odd part of n + 1 (FIPS 186-4, C.3.3).
+ */
+bool strong_lucas(montgomery &field, big_integer const &n) {
+	int64_t d = 5;
+	for (int attempt = 0;; ++attempt) {
+		int symbol = jacobi(d, n);
+		if (symbol == -1) {
+			break;
+		}
+		if (symbol == 0) {
+			return false;
+		}
+		// no D exists for squares
+		if (attempt == 8 && is_square(n)) {
+			return false;
+		}
+		d = d > 0 ? -(d + 2) : -d + 2;
+	}
+
+	big_integer k = n + 1;
+	size_t s = k.countr_zero();
+	k >>= static_cast<uint32_t>(s);
+
+	limbs discriminant = field.to_form(static_cast<int>(d));
+	limbs u = field.one();
+	limbs v = field.one();
+	limbs u_double = field.zero();
+	limbs v_double = field.zero();
+	limbs scratch = field.zero();
+	for (size_t i = k.bit_length() - 1; i-- > 0;) {
+		field.multiply(u_double, u, v);
+		field.square(v_double, v);
+		field.square(scratch, u);
+		field.multiply(scratch, scratch, discriminant);
+		field.add(v_double, v_double, scratch);
+		field.halve(v_double);
+		if (k.test_bit(i)) {
+			field.add(u, u_double, v_double);
+			field.halve(u);
+			field.multiply(scratch, u_double, discriminant);
+			field.add(v, v_double, scratch);
+			field.halve(v);
+		} else {
+			u.swap(u_double);
+			v.swap(v_double);
+		}
+	}
+
+	limbs zero = field.zero();
+	if (u == zero || v == zero) {
+		return true;
+	}
+	limbs q_power = field.power(field.to_form(static_cast<int>((1 - d) / 4)), k);
+	for (size_t r = 1; r < s; ++r) {
+		field.square(v, v);
+		field.subtract(v, v, q_power);
+		field.subtract(v, v, q_power);
+		if (v == zero) {
+			return true;
+		}
+		field.square(q_power, q_power);
+	}
+	return false;
+}
+
+// For odd n without small factors
+bool baillie_psw(big_integer const &n) {
+	montgomery field(n);
+	return miller_rabin(field, n, 2) && strong_lucas(field, n);
+}
+}
+
+bool is_probable_prime(big_integer const &n) {
+	if (n < 2) {
+		return false;
+	}
+	if (!n.test_bit(0)) {
+		return n == 2;
+	}
+	small_primes const &small = get_small_primes();
+	if (n < SMALL_PRIME_LIMIT) {
+		return std::binary_search(small.primes.begin(), small.primes.end(), n[0]);
+	}
+
+	std::vector<uint32_t> residues = small.residues(n);
+	if (std::find(residues.begin(), residues.end(), 0) != residues.end()) {
+		return false;
+	}
+	if (n < SMALL_PRIME_LIMIT * SMALL_PRIME_LIMIT) {
+		return true;
+	}
+	return baillie_psw(n);
+}
+
+bool is_probable_prime(big_integer const &n, size_t rounds, std::function<uint64_t()> const &next) {
+	if (!is_probable_prime(n)) {
+		return false;
+	}
+	if (n < SMALL_PRIME_LIMIT * SMALL_PRIME_LIMIT) {
+		return true;
+	}
+	montgomery field(n);
+	for (size_t i = 0; i < rounds; ++i) {
+		// a base in [2, n - 2]
+		if (!miller_rabin(field, n, big_integer::random_below(n - 3, next) + 2)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/*
+ * Candidates are sieved: the residues of the first one modulo the small
+ * primes are found once and stepped by 2, so only the survivors pay for a
+ * Baillie-PSW test.
+ */
+big_integer next_prime(big_integer const &n) {
+	if (n < 2) {
+		return 2;
+	}
+	big_integer start = n + 1;
+	if (!start.test_bit(0)) {
+		++start;
+	}
+	if (start < SMALL_PRIME_LIMIT * SMALL_PRIME_LIMIT) {
+		while (!is_probable_prime(start)) {
+			start += 2;
+		}
+		return start;
+	}
+
+	small_primes const &small = get_small_primes();
+	std::vector<uint32_t> residues = small.residues(start);
+	for (uint32_t step = 0;; step += 2) {
+		if (std::find(residues.begin(), residues.end(), 0) == residues.end()) {
+			big_integer candidate = start + step;
+			if (baillie_psw(candidate)) {
+				return candidate;
+			}
+		}
+		for (size_t i = 0; i < residues.size(); ++i) {
+			residues[i] += 2;
+			if (residues[i] >= small.primes[i]) {
+				residues[i] -= small.primes[i];
+			}
+		}
+	}
+}
@@ -0,0 +1,22 @@
+#ifndef BIGINT__BIG_INTEGER_PRIME_H_
+#define BIGINT__BIG_INTEGER_PRIME_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include "big_integer.h"
+
+/*
+ * Baillie-PSW test: trial division by the odd primes below 4096, then a
+ * base 2 Miller-Rabin test and a strong Lucas test with Selfridge's
+ * parameters. No composite is known to pass it, and the answer is exact
+ * below 2^64. The second overload adds rounds of Miller-Rabin with random
+ * bases taken from next.
+ */
+bool is_probable_prime(big_integer const &n);
+bool is_probable_prime(big_integer const &n, size_t rounds, std::function<uint64_t()> const &next);
+
+// The smallest probable prime greater than n
+big_integer next_prime(big_integer const &n);
+
+#endif //BIGINT__BIG_INTEGER_PRIME_H_
@@ -0,0 +1,210 @@
+#include "big_integer_trace.h"
+#include "host_endian.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+char const MAGIC[4] = {'B', 'I', 'G', 'T'};
+uint32_t constexpr VERSION = 1;
+
+uint8_t constexpr LHS_NEGATIVE = 1;
+uint8_t constexpr RHS_NEGATIVE = 2;
+uint8_t constexpr HAS_VALUES = 4;
+size_t constexpr READ_CHUNK = 1 << 16;
+
+char const *const OP_NAMES[TRACE_OP_COUNT] = {
+	"add",
+	"subtract",
+	"multiply",
+	"divide",
+	"remainder",
+	"and",
+	"or",
+	"xor",
+	"shift_left",
+	"shift_right",
+	"equal",
+	"less",
+	"to_string",
+	"from_string",
+	"write_text",
+	"read_text",
+	"export_bits",
+	"import_bits",
+	"write_binary",
+	"read_binary",
+};
+
+// LEB128, at most 10 bytes; returns the end of what was written
+char *put_varint(char *out, uint64_t value) {
+	while (value >= 0x80) {
+		*out++ = static_cast<char>(value | 0x80);
+		value >>= 7;
+	}
+	*out++ = static_cast<char>(value);
+	return out;
+}
+
+uint64_t get_varint(std::istream &in) {
+	uint64_t value = 0;
+	for (unsigned shift = 0; shift < 64; shift += 7) {
+		int c = in.get();
+		if (c == std::char_traits<char>::eof()) {
+			throw std::runtime_error("big_integer: truncated trace record");
+		}
+		value |= static_cast<uint64_t>(c & 0x7F) << shift;
+		if (!(c & 0x80)) {
+			return value;
+		}
+	}
+	throw std::runtime_error("big_integer: bad varint in trace");
+}
+
+void put_limbs(std::ostream &out, big_integer_view a) {
+	if (little_endian_host) {
+		out.write(reinterpret_cast<char const *>(a.data()), a.size() * sizeof(uint32_t));
+		return;
+	}
+	for (size_t i = 0; i < a.size(); ++i) {
+		char limb[sizeof(uint32_t)];
+		for (size_t j = 0; j < sizeof(limb); ++j) {
+			limb[j] = static_cast<char>(a[i] >> (8 * j));
+		}
+		out.write(limb, sizeof(limb));
+	}
+}
+
+// Grows limbs only as data arrives, so a corrupt size cannot allocate past the end of the trace
+void get_limbs(std::istream &in, std::vector<uint32_t> &limbs, uint64_t size) {
+	limbs.clear();
+	while (limbs.size() < size) {
+		size_t done = limbs.size();
+		size_t count = static_cast<size_t>(std::min<uint64_t>(size - done, READ_CHUNK));
+		limbs.resize(done + count);
+		if (!in.read(reinterpret_cast<char *>(limbs.data() + done), count * sizeof(uint32_t))) {
+			throw std::runtime_error("big_integer: truncated trace values");
+		}
+	}
+	if (!little_endian_host) {
+		for (uint32_t &limb : limbs) {
+			unsigned char const *bytes = reinterpret_cast<unsigned char const *>(&limb);
+			limb = bytes[0] | bytes[1] << 8 | bytes[2] << 16 | static_cast<uint32_t>(bytes[3]) << 24;
+		}
+	}
+}
+}
+
+char const *trace_op_name(trace_op op) {
+	size_t index = static_cast<size_t>(op);
+	return index < TRACE_OP_COUNT ? OP_NAMES[index] : "unknown";
+}
+
+bool trace_op_has_argument(trace_op op) {
+	switch (op) {
+		case trace_op::add:
+		case trace_op::subtract:
+		case trace_op::multiply:
+		case trace_op::divide:
+		case trace_op::remainder:
+		case trace_op::bit_and:
+		case trace_op::bit_or:
+		case trace_op::bit_xor:
+		case trace_op::equal:
+		case trace_op::less:
+			return false;
+		default:
+			return true;
+	}
+}
+
+/* * * * * * * * * trace_writer * * * * * * * * * */
+
+trace_writer::trace_writer(std::ostream &out, bool values) : out_(out), values_(values) {
+	char header[8];
+	std::memcpy(header, MAGIC, sizeof(MAGIC));
+	for (size_t i = 0; i < 4; ++i) {
+		header[4 + i] = static_cast<char>(VERSION >> (8 * i));
+	}
+	out_.write(header, sizeof(header));
+}
+
+trace_writer::~trace_writer() {
+	out_.flush();
+}
+
+void trace_writer::write(trace_op op, big_integer_view lhs, big_integer_view rhs) {
+	write(op, lhs, rhs.is_negative(), rhs.size(), &rhs);
+}
+
+void trace_writer::write(trace_op op, big_integer_view lhs, uint64_t argument) {
+	write(op, lhs, false, argument, nullptr);
+}
+
+void trace_writer::write(trace_op op,
+						 big_integer_view lhs,
+						 bool rhs_negative,
+						 uint64_t rhs_size,
+						 big_integer_view const *rhs) {
+	char record[22];
+	record[0] = static_cast<char>(op);
+	record[1] = static_cast<char>((lhs.is_negative() ? LHS_NEGATIVE : 0)
+								  | (rhs_negative ? RHS_NEGATIVE : 0)
+								  | (values_ ? HAS_VALUES : 0));
+	char *end = put_varint(put_varint(record + 2, lhs.size()), rhs_size);
+
+	std::lock_guard<std::mutex> guard(lock_);
+	out_.write(record, end - record);
+	if (values_) {
+		put_limbs(out_, lhs);
+		if (rhs) {
+			put_limbs(out_, *rhs);
+		}
+	}
+}
+
+/* * * * * * * * * trace_reader * * * * * * * * * */
+
+trace_reader::trace_reader(std::istream &in) : in_(in) {
+	char header[8];
+	if (!in_.read(header, sizeof(header)) || std::memcmp(header, MAGIC, sizeof(MAGIC)) != 0) {
+		throw std::runtime_error("big_integer: not a big_integer trace");
+	}
+	uint32_t version = 0;
+	for (size_t i = 0; i < 4; ++i) {
+		version |= static_cast<uint32_t>(static_cast<unsigned char>(header[4 + i])) << (8 * i);
+	}
+	if (version != VERSION) {
+		throw std::runtime_error("big_integer: unsupported trace version");
+	}
+}
+
+bool trace_reader::next(trace_record &record) {
+	int op = in_.get();
+	if (op == std::char_traits<char>::eof()) {
+		return false;
+	}
+	int flags = in_.get();
+	if (flags == std::char_traits<char>::eof()) {
+		throw std::runtime_error("big_integer: truncated trace record");
+	}
+	if (static_cast<size_t>(op) >= TRACE_OP_COUNT) {
+		throw std::runtime_error("big_integer: unknown operation in trace");
+	}
+
+	record.op = static_cast<trace_op>(op);
+	record.lhs_negative = flags & LHS_NEGATIVE;
+	record.rhs_negative = flags & RHS_NEGATIVE;
+	record.lhs_size = get_varint(in_);
+	record.rhs_size = get_varint(in_);
+	record.lhs.clear();
+	record.rhs.clear();
+	if (flags & HAS_VALUES) {
+		get_limbs(in_, record.lhs, record.lhs_size);
+		if (!trace_op_has_argument(record.op)) {
+			get_limbs(in_, record.rhs, record.rhs_size);
+		}
+	}
+	return true;
+}
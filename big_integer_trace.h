@@ -0,0 +1,119 @@
+#ifndef BIGINT__BIG_INTEGER_TRACE_H_
+#define BIGINT__BIG_INTEGER_TRACE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <mutex>
+#include <ostream>
+#include <vector>
+#include "big_integer.h"
+
+/*
+ * Trace format: the magic "BIGT" and a 32-bit version, then one record per
+ * operation. A record is the operation byte, a flags byte (bits 0 and 1:
+ * the operands are negative, bit 2: their values follow), the limb counts
+ * of both operands as LEB128 varints and, when captured, the limbs of both.
+ * Single-operand operations take a plain argument instead of a right
+ * operand: the shift, the base of text conversions (8, 10 or 16 for
+ * streams), the word size of bit import and export, and 0 for the binary
+ * format. Reads record the value they produced. Everything is little-endian.
+ */
+enum class trace_op : uint8_t {
+	add,
+	subtract,
+	multiply,
+	divide,
+	remainder,
+	bit_and,
+	bit_or,
+	bit_xor,
+	shift_left,
+	shift_right,
+	equal,
+	less,
+	to_string,
+	from_string,
+	write_text,
+	read_text,
+	export_bits,
+	import_bits,
+	write_binary,
+	read_binary
+};
+
+size_t constexpr TRACE_OP_COUNT = static_cast<size_t>(trace_op::read_binary) + 1;
+
+char const *trace_op_name(trace_op op);
+bool trace_op_has_argument(trace_op op);
+
+struct trace_record {
+	trace_op op;
+	bool lhs_negative;
+	bool rhs_negative;
+	uint64_t lhs_size;
+	// limbs of the right operand, or the plain argument
+	uint64_t rhs_size;
+	// empty unless the values were captured
+	std::vector<uint32_t> lhs;
+	std::vector<uint32_t> rhs;
+};
+
+class trace_writer {
+	std::ostream &out_;
+	bool values_;
+	std::mutex lock_;
+
+	void write(trace_op op, big_integer_view lhs, bool rhs_negative, uint64_t rhs_size, big_integer_view const *rhs);
+
+ public:
+	trace_writer(std::ostream &out, bool values);
+	~trace_writer();
+
+	void write(trace_op op, big_integer_view lhs, big_integer_view rhs);
+	void write(trace_op op, big_integer_view lhs, uint64_t argument);
+};
+
+/*
+ * Reads records back one at a time. Throws std::runtime_error on a bad
+ * header or a truncated record.
+ */
+class trace_reader {
+	std::istream &in_;
+
+ public:
+	explicit trace_reader(std::istream &in);
+
+	// false at the end of the trace
+	bool next(trace_record &record);
+};
+
+// Records only the outermost operation of a call, what it runs internally is part of its cost
+struct big_integer::trace_scope {
+	static thread_local size_t depth;
+
+	trace_writer *writer;
+	bool outermost;
+
+	trace_scope() : writer(tracer_.get()), outermost(writer && depth++ == 0) {}
+
+	~trace_scope() {
+		if (writer) {
+			--depth;
+		}
+	}
+
+	void record(trace_op op, big_integer_view lhs, big_integer_view rhs) {
+		if (outermost) {
+			writer->write(op, lhs, rhs);
+		}
+	}
+
+	void record(trace_op op, big_integer_view lhs, uint64_t argument) {
+		if (outermost) {
+			writer->write(op, lhs, argument);
+		}
+	}
+};
+
+#endif //BIGINT__BIG_INTEGER_TRACE_H_
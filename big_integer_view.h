@@ -0,0 +1,54 @@
+#ifndef BIGINT__BIG_INTEGER_VIEW_H_
+#define BIGINT__BIG_INTEGER_VIEW_H_
+
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * Non-owning, read-only big_integer: a sign and little-endian 32-bit limbs
+ * that live somewhere else (a big_integer, a network frame, a mapped file).
+ * The memory must outlive the view and stay unchanged while it is used.
+ * Leading zero limbs are dropped, so zero is the empty view.
+ */
+class big_integer_view {
+	uint32_t const *limbs_;
+	size_t size_;
+	bool sign_;
+
+ public:
+	big_integer_view(uint32_t const *limbs, size_t size, bool negative = false)
+		: limbs_(limbs), size_(size), sign_(negative) {
+		while (size_ > 0 && limbs_[size_ - 1] == 0) {
+			--size_;
+		}
+		if (size_ == 0) {
+			sign_ = false;
+		}
+	}
+
+	uint32_t const *data() const {
+		return limbs_;
+	}
+
+	size_t size() const {
+		return size_;
+	}
+
+	bool is_negative() const {
+		return sign_;
+	}
+
+	uint32_t operator[](size_t pos) const {
+		return limbs_[pos];
+	}
+
+	big_integer_view magnitude() const {
+		return big_integer_view(limbs_, size_);
+	}
+
+	big_integer_view operator-() const {
+		return big_integer_view(limbs_, size_, !sign_);
+	}
+};
+
+#endif //BIGINT__BIG_INTEGER_VIEW_H_
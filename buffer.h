@@ -5,6 +5,7 @@
 #ifndef BIGINT__BUFFER_H_
 #define BIGINT__BUFFER_H_
 
+#include <algorithm>
 #include <cstddef>
 #include <cstdint>
 #include <memory>
@@ -27,10 +28,10 @@ class buffer {
 	}
 
 	void ensure_type(size_t sz) {
-		if (sz >= STATIC_SIZE) {
+		if (is_small && sz >= STATIC_SIZE) {
+			shared_vector *moved = new shared_vector(static_data, static_data + std::min(size_, STATIC_SIZE), sz);
 			is_small = false;
-			std::vector<uint32_t> static_data_vector(static_data, static_data + STATIC_SIZE);
-			dynamic_data = new shared_vector(static_data_vector);
+			dynamic_data = moved;
 		}
 	}
 
@@ -96,6 +97,23 @@ class buffer {
 		}
 	}
 
+	uint32_t *data() {
+		if (is_small) {
+			return static_data;
+		} else {
+			ensure_uniqueness();
+			return dynamic_data->begin();
+		}
+	}
+
+	uint32_t const *data() const {
+		if (is_small) {
+			return static_data;
+		} else {
+			return dynamic_data->begin();
+		}
+	}
+
 	friend bool operator==(buffer const &a, buffer const &b) {
 		if (a.size_ != b.size_) {
 			return false;
@@ -117,10 +135,8 @@ class buffer {
 			ensure_uniqueness();
 			ensure_type(sz);
 			if (!is_small) {
+				// new elements are zeroed by the vector itself
 				dynamic_data->resize(sz);
-				for (size_t i = size_; i < STATIC_SIZE; ++i) {
-					(*dynamic_data)[i] = 0;
-				}
 			} else {
 				for (size_t i = size_; i < sz; ++i) {
 					static_data[i] = 0;
@@ -161,6 +177,56 @@ class buffer {
 		}
 	}
 
+	size_t capacity() const {
+		return is_small ? STATIC_SIZE : dynamic_data->capacity();
+	}
+
+	void reserve(size_t capacity) {
+		if (capacity <= this->capacity()) {
+			return;
+		}
+		ensure_uniqueness();
+		ensure_type(capacity);
+		dynamic_data->reserve(capacity);
+	}
+
+	// Moves short numbers back into the object and trims spare heap capacity
+	void shrink_to_fit() {
+		if (is_small) {
+			return;
+		}
+		if (size_ < STATIC_SIZE) {
+			shared_vector *old = dynamic_data;
+			std::copy(old->begin(), old->begin() + size_, static_data);
+			is_small = true;
+			old->destroy();
+		} else if (dynamic_data->capacity() > size_) {
+			ensure_uniqueness();
+			dynamic_data->shrink_to_fit();
+		}
+	}
+
+	/*
+	 * Drops everything past the first sz elements in one step. Unique
+	 * storage is cut in place; shared storage is left to its other owners
+	 * and only the kept prefix is copied.
+	 */
+	void truncate_to(size_t sz) {
+		if (sz >= size_) {
+			return;
+		}
+		if (!is_small) {
+			if (dynamic_data->use_count() == 1) {
+				dynamic_data->resize(sz);
+			} else {
+				shared_vector *prefix = new shared_vector(dynamic_data->begin(), dynamic_data->begin() + sz, sz);
+				dynamic_data->destroy();
+				dynamic_data = prefix;
+			}
+		}
+		size_ = sz;
+	}
+
 };
 
 #endif //BIGINT__BUFFER_H_
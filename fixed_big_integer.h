@@ -0,0 +1,409 @@
+#ifndef BIGINT__FIXED_BIG_INTEGER_H_
+#define BIGINT__FIXED_BIG_INTEGER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include "big_integer.h"
+
+/*
+ * Integer of exactly Bits bits stored inline as Bits / 32 little-endian limbs.
+ * Signed values use two's complement, arithmetic wraps modulo 2^Bits like the
+ * built-in types. Every loop runs over a compile-time number of limbs, nothing
+ * allocates, and all arithmetic is usable in constant expressions.
+ */
+template<size_t Bits, bool Signed = true>
+class fixed_big_integer {
+	static_assert(Bits > 0 && Bits % 32 == 0, "fixed_big_integer width must be a positive multiple of 32 bits");
+
+	static size_t constexpr LIMBS = Bits / 32;
+
+	uint32_t limbs_[LIMBS];
+
+	/* * * * * * * * * Limb helpers * * * * * * * * * */
+
+	static constexpr size_t significant_limbs(uint32_t const (&a)[LIMBS]) {
+		size_t n = LIMBS;
+		while (n > 0 && a[n - 1] == 0) {
+			--n;
+		}
+		return n;
+	}
+
+	static constexpr uint32_t leading_zeros(uint32_t a) {
+		uint32_t n = 0;
+		while (n < 32 && !(a & (UINT32_C(1) << (31 - n)))) {
+			++n;
+		}
+		return n;
+	}
+
+	static constexpr void divide_unsigned(uint32_t const (&u)[LIMBS],
+										  uint32_t const (&v)[LIMBS],
+										  uint32_t (&q)[LIMBS],
+										  uint32_t (&r)[LIMBS]) {
+		for (size_t i = 0; i < LIMBS; ++i) {
+			q[i] = 0;
+			r[i] = 0;
+		}
+		size_t n = significant_limbs(v);
+		size_t m = significant_limbs(u);
+		if (n == 0) {
+			// not a constant expression, so dividing by zero fails to compile there
+			throw std::domain_error("fixed_big_integer: division by zero");
+		}
+		if (m < n) {
+			for (size_t i = 0; i < LIMBS; ++i) {
+				r[i] = u[i];
+			}
+			return;
+		}
+
+		if (n == 1) {
+			uint64_t curr = 0;
+			for (size_t i = m; i-- > 0;) {
+				curr = (curr << 32) | u[i];
+				q[i] = static_cast<uint32_t>(curr / v[0]);
+				curr %= v[0];
+			}
+			r[0] = static_cast<uint32_t>(curr);
+			return;
+		}
+
+		// Knuth's algorithm D on normalized copies of u and v
+		uint32_t shift = leading_zeros(v[n - 1]);
+		uint32_t vn[LIMBS] = {};
+		uint32_t un[LIMBS + 1] = {};
+		for (size_t i = n - 1; i > 0; --i) {
+			vn[i] = shift ? (v[i] << shift) | (v[i - 1] >> (32 - shift)) : v[i];
+		}
+		vn[0] = v[0] << shift;
+		un[m] = shift ? u[m - 1] >> (32 - shift) : 0;
+		for (size_t i = m - 1; i > 0; --i) {
+			un[i] = shift ? (u[i] << shift) | (u[i - 1] >> (32 - shift)) : u[i];
+		}
+		un[0] = u[0] << shift;
+
+		for (size_t j = m - n + 1; j-- > 0;) {
+			uint64_t numerator = (static_cast<uint64_t>(un[j + n]) << 32) | un[j + n - 1];
+			uint64_t q_digit = numerator / vn[n - 1];
+			uint64_t r_digit = numerator % vn[n - 1];
+			while (q_digit > UINT32_MAX
+				|| q_digit * vn[n - 2] > ((r_digit << 32) | un[j + n - 2])) {
+				--q_digit;
+				r_digit += vn[n - 1];
+				if (r_digit > UINT32_MAX) {
+					break;
+				}
+			}
+
+			int64_t borrow = 0;
+			for (size_t i = 0; i < n; ++i) {
+				uint64_t product = q_digit * vn[i];
+				int64_t t = static_cast<int64_t>(un[i + j]) - borrow - static_cast<int64_t>(product & UINT32_MAX);
+				un[i + j] = static_cast<uint32_t>(t);
+				borrow = static_cast<int64_t>(product >> 32) - (t >> 32);
+			}
+			int64_t t = static_cast<int64_t>(un[j + n]) - borrow;
+			un[j + n] = static_cast<uint32_t>(t);
+
+			if (t < 0) {
+				--q_digit;
+				uint64_t carry = 0;
+				for (size_t i = 0; i < n; ++i) {
+					uint64_t sum = static_cast<uint64_t>(un[i + j]) + vn[i] + carry;
+					un[i + j] = static_cast<uint32_t>(sum);
+					carry = sum >> 32;
+				}
+				un[j + n] += static_cast<uint32_t>(carry);
+			}
+			q[j] = static_cast<uint32_t>(q_digit);
+		}
+
+		for (size_t i = 0; i < n; ++i) {
+			r[i] = shift ? (un[i] >> shift) | (un[i + 1] << (32 - shift)) : un[i];
+		}
+	}
+
+	constexpr fixed_big_integer magnitude() const {
+		return is_negative() ? -*this : *this;
+	}
+
+ public:
+	/* * * * * * * * * Constructors * * * * * * * * * */
+
+	constexpr fixed_big_integer() : limbs_{} {}
+
+	// Any built-in integer, sign extended and reduced modulo 2^Bits like a cast
+	template<typename T, typename = typename std::enable_if<std::is_integral<T>::value>::type>
+	constexpr fixed_big_integer(T a) : limbs_{} {
+		uint64_t value = static_cast<uint64_t>(a);
+		bool negative = std::is_signed<T>::value && static_cast<int64_t>(value) < 0;
+		limbs_[0] = static_cast<uint32_t>(value);
+		for (size_t i = 1; i < LIMBS; ++i) {
+			limbs_[i] = i == 1 ? static_cast<uint32_t>(value >> 32) : negative ? UINT32_MAX : 0;
+		}
+	}
+
+	/*
+	 * Exact for values representable in Bits bits, otherwise the value is
+	 * reduced modulo 2^Bits.
+	 */
+	explicit fixed_big_integer(big_integer const &a) : limbs_{} {
+		for (size_t i = 0; i < LIMBS && i < a.data_.size(); ++i) {
+			limbs_[i] = a.data_[i];
+		}
+		if (a.sign_) {
+			*this = -*this;
+		}
+	}
+
+	explicit operator big_integer() const {
+		fixed_big_integer abs = magnitude();
+		buffer data;
+		data.resize(LIMBS);
+		for (size_t i = 0; i < LIMBS; ++i) {
+			data[i] = abs.limbs_[i];
+		}
+		return big_integer(is_negative(), data).trim();
+	}
+
+	/* * * * * * * * * Accessors * * * * * * * * * */
+
+	constexpr uint32_t operator[](size_t pos) const {
+		return limbs_[pos];
+	}
+
+	constexpr bool is_negative() const {
+		return Signed && (limbs_[LIMBS - 1] >> 31);
+	}
+
+	/* * * * * * * * * Arithmetic * * * * * * * * * */
+
+	constexpr fixed_big_integer &operator+=(fixed_big_integer const &rhs) {
+		uint64_t carry = 0;
+		for (size_t i = 0; i < LIMBS; ++i) {
+			uint64_t sum = static_cast<uint64_t>(limbs_[i]) + rhs.limbs_[i] + carry;
+			limbs_[i] = static_cast<uint32_t>(sum);
+			carry = sum >> 32;
+		}
+		return *this;
+	}
+
+	constexpr fixed_big_integer &operator-=(fixed_big_integer const &rhs) {
+		uint32_t borrow = 0;
+		for (size_t i = 0; i < LIMBS; ++i) {
+			uint64_t diff = static_cast<uint64_t>(limbs_[i]) - rhs.limbs_[i] - borrow;
+			limbs_[i] = static_cast<uint32_t>(diff);
+			borrow = static_cast<uint32_t>(diff >> 63);
+		}
+		return *this;
+	}
+
+	constexpr fixed_big_integer &operator*=(fixed_big_integer const &rhs) {
+		uint32_t res[LIMBS] = {};
+		for (size_t i = 0; i < LIMBS; ++i) {
+			uint64_t carry = 0;
+			for (size_t j = 0; i + j < LIMBS; ++j) {
+				uint64_t digit = res[i + j] + static_cast<uint64_t>(limbs_[i]) * rhs.limbs_[j] + carry;
+				res[i + j] = static_cast<uint32_t>(digit);
+				carry = digit >> 32;
+			}
+		}
+		for (size_t i = 0; i < LIMBS; ++i) {
+			limbs_[i] = res[i];
+		}
+		return *this;
+	}
+
+	/*
+	 * Truncating division like the built-in types: the quotient rounds towards
+	 * zero and the remainder takes the sign of the dividend. Dividing by zero
+	 * throws std::domain_error, or fails to compile in a constant expression.
+	 */
+	constexpr fixed_big_integer &operator/=(fixed_big_integer const &rhs) {
+		bool negative = is_negative() != rhs.is_negative();
+		fixed_big_integer quotient, remainder;
+		divide_unsigned(magnitude().limbs_, rhs.magnitude().limbs_, quotient.limbs_, remainder.limbs_);
+		return *this = negative ? -quotient : quotient;
+	}
+
+	constexpr fixed_big_integer &operator%=(fixed_big_integer const &rhs) {
+		bool negative = is_negative();
+		fixed_big_integer quotient, remainder;
+		divide_unsigned(magnitude().limbs_, rhs.magnitude().limbs_, quotient.limbs_, remainder.limbs_);
+		return *this = negative ? -remainder : remainder;
+	}
+
+	constexpr fixed_big_integer &operator&=(fixed_big_integer const &rhs) {
+		for (size_t i = 0; i < LIMBS; ++i) {
+			limbs_[i] &= rhs.limbs_[i];
+		}
+		return *this;
+	}
+
+	constexpr fixed_big_integer &operator|=(fixed_big_integer const &rhs) {
+		for (size_t i = 0; i < LIMBS; ++i) {
+			limbs_[i] |= rhs.limbs_[i];
+		}
+		return *this;
+	}
+
+	constexpr fixed_big_integer &operator^=(fixed_big_integer const &rhs) {
+		for (size_t i = 0; i < LIMBS; ++i) {
+			limbs_[i] ^= rhs.limbs_[i];
+		}
+		return *this;
+	}
+
+	constexpr fixed_big_integer &operator<<=(uint32_t rhs) {
+		size_t shift_digits = rhs / 32;
+		uint32_t shift_number = rhs % 32;
+		for (size_t i = LIMBS; i-- > 0;) {
+			uint32_t high = i >= shift_digits ? limbs_[i - shift_digits] : 0;
+			uint32_t low = i >= shift_digits + 1 ? limbs_[i - shift_digits - 1] : 0;
+			limbs_[i] = shift_number ? (high << shift_number) | (low >> (32 - shift_number)) : high;
+		}
+		return *this;
+	}
+
+	/*
+	 * Arithmetic shift for signed values (rounds towards negative infinity),
+	 * logical shift for unsigned ones.
+	 */
+	constexpr fixed_big_integer &operator>>=(uint32_t rhs) {
+		uint32_t fill = is_negative() ? UINT32_MAX : 0;
+		size_t shift_digits = rhs / 32;
+		uint32_t shift_number = rhs % 32;
+		for (size_t i = 0; i < LIMBS; ++i) {
+			uint32_t low = i + shift_digits < LIMBS ? limbs_[i + shift_digits] : fill;
+			uint32_t high = i + shift_digits + 1 < LIMBS ? limbs_[i + shift_digits + 1] : fill;
+			limbs_[i] = shift_number ? (low >> shift_number) | (high << (32 - shift_number)) : low;
+		}
+		return *this;
+	}
+
+	constexpr fixed_big_integer operator+() const {
+		return *this;
+	}
+
+	constexpr fixed_big_integer operator-() const {
+		fixed_big_integer res = ~*this;
+		return res += 1u;
+	}
+
+	constexpr fixed_big_integer operator~() const {
+		fixed_big_integer res;
+		for (size_t i = 0; i < LIMBS; ++i) {
+			res.limbs_[i] = ~limbs_[i];
+		}
+		return res;
+	}
+
+	constexpr fixed_big_integer &operator++() {
+		return *this += 1u;
+	}
+
+	constexpr fixed_big_integer operator++(int) {
+		fixed_big_integer res = *this;
+		++*this;
+		return res;
+	}
+
+	constexpr fixed_big_integer &operator--() {
+		return *this -= 1u;
+	}
+
+	constexpr fixed_big_integer operator--(int) {
+		fixed_big_integer res = *this;
+		--*this;
+		return res;
+	}
+
+	friend constexpr fixed_big_integer operator+(fixed_big_integer a, fixed_big_integer const &b) {
+		return a += b;
+	}
+
+	friend constexpr fixed_big_integer operator-(fixed_big_integer a, fixed_big_integer const &b) {
+		return a -= b;
+	}
+
+	friend constexpr fixed_big_integer operator*(fixed_big_integer a, fixed_big_integer const &b) {
+		return a *= b;
+	}
+
+	friend constexpr fixed_big_integer operator/(fixed_big_integer a, fixed_big_integer const &b) {
+		return a /= b;
+	}
+
+	friend constexpr fixed_big_integer operator%(fixed_big_integer a, fixed_big_integer const &b) {
+		return a %= b;
+	}
+
+	friend constexpr fixed_big_integer operator&(fixed_big_integer a, fixed_big_integer const &b) {
+		return a &= b;
+	}
+
+	friend constexpr fixed_big_integer operator|(fixed_big_integer a, fixed_big_integer const &b) {
+		return a |= b;
+	}
+
+	friend constexpr fixed_big_integer operator^(fixed_big_integer a, fixed_big_integer const &b) {
+		return a ^= b;
+	}
+
+	friend constexpr fixed_big_integer operator<<(fixed_big_integer a, uint32_t b) {
+		return a <<= b;
+	}
+
+	friend constexpr fixed_big_integer operator>>(fixed_big_integer a, uint32_t b) {
+		return a >>= b;
+	}
+
+	/* * * * * * * * * Сomparison operators * * * * * * * * * */
+
+	friend constexpr bool operator==(fixed_big_integer const &a, fixed_big_integer const &b) {
+		for (size_t i = 0; i < LIMBS; ++i) {
+			if (a.limbs_[i] != b.limbs_[i]) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	friend constexpr bool operator!=(fixed_big_integer const &a, fixed_big_integer const &b) {
+		return !(a == b);
+	}
+
+	friend constexpr bool operator<(fixed_big_integer const &a, fixed_big_integer const &b) {
+		if (a.is_negative() != b.is_negative()) {
+			return a.is_negative();
+		}
+		for (size_t i = LIMBS; i-- > 0;) {
+			if (a.limbs_[i] != b.limbs_[i]) {
+				return a.limbs_[i] < b.limbs_[i];
+			}
+		}
+		return false;
+	}
+
+	friend constexpr bool operator>(fixed_big_integer const &a, fixed_big_integer const &b) {
+		return b < a;
+	}
+
+	friend constexpr bool operator<=(fixed_big_integer const &a, fixed_big_integer const &b) {
+		return !(b < a);
+	}
+
+	friend constexpr bool operator>=(fixed_big_integer const &a, fixed_big_integer const &b) {
+		return !(a < b);
+	}
+
+	friend std::string to_string(fixed_big_integer const &a) {
+		return to_string(static_cast<big_integer>(a));
+	}
+};
+
+#endif //BIGINT__FIXED_BIG_INTEGER_H_
@@ -0,0 +1,15 @@
+#ifndef BIGINT__HOST_ENDIAN_H_
+#define BIGINT__HOST_ENDIAN_H_
+
+/*
+ * Internal: whether the host stores integers least significant byte first,
+ * the byte order of the binary and trace formats, so limbs can be copied
+ * in bulk.
+ */
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+bool constexpr little_endian_host = true;
+#else
+bool constexpr little_endian_host = false;
+#endif
+
+#endif //BIGINT__HOST_ENDIAN_H_
@@ -0,0 +1,401 @@
+#include "limb_kernels.h"
+
+#include <cstring>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define BIGINT_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
+namespace {
+
+/* * * * * * * * * Portable kernels * * * * * * * * * */
+
+uint32_t add_n_portable(uint32_t *r, uint32_t const *a, uint32_t const *b, size_t n) {
+	uint64_t carry = 0;
+	for (size_t i = 0; i < n; ++i) {
+		uint64_t sum = static_cast<uint64_t>(a[i]) + b[i] + carry;
+		r[i] = static_cast<uint32_t>(sum);
+		carry = sum >> 32;
+	}
+	return static_cast<uint32_t>(carry);
+}
+
+uint32_t sub_n_portable(uint32_t *r, uint32_t const *a, uint32_t const *b, size_t n) {
+	uint32_t borrow = 0;
+	for (size_t i = 0; i < n; ++i) {
+		uint64_t difference = static_cast<uint64_t>(a[i]) - b[i] - borrow;
+		r[i] = static_cast<uint32_t>(difference);
+		borrow = static_cast<uint32_t>(difference >> 63);
+	}
+	return borrow;
+}
+
+uint32_t mul_1_portable(uint32_t *r, uint32_t const *a, size_t n, uint32_t b) {
+	uint64_t carry = 0;
+	for (size_t i = 0; i < n; ++i) {
+		uint64_t product = static_cast<uint64_t>(a[i]) * b + carry;
+		r[i] = static_cast<uint32_t>(product);
+		carry = product >> 32;
+	}
+	return static_cast<uint32_t>(carry);
+}
+
+uint32_t addmul_1_portable(uint32_t *r, uint32_t const *a, size_t n, uint32_t b) {
+	uint64_t carry = 0;
+	for (size_t i = 0; i < n; ++i) {
+		uint64_t product = static_cast<uint64_t>(a[i]) * b + r[i] + carry;
+		r[i] = static_cast<uint32_t>(product);
+		carry = product >> 32;
+	}
+	return static_cast<uint32_t>(carry);
+}
+
+uint32_t submul_1_portable(uint32_t *r, uint32_t const *a, size_t n, uint32_t b) {
+	uint32_t borrow = 0;
+	for (size_t i = 0; i < n; ++i) {
+		uint64_t product = static_cast<uint64_t>(a[i]) * b + borrow;
+		uint32_t low = static_cast<uint32_t>(product);
+		uint32_t digit = r[i];
+		r[i] = digit - low;
+		borrow = static_cast<uint32_t>(product >> 32) + (digit < low);
+	}
+	return borrow;
+}
+
+uint32_t lshift_portable(uint32_t *r, uint32_t const *a, size_t n, unsigned shift) {
+	if (n == 0) {
+		return 0;
+	}
+	uint32_t out = a[n - 1] >> (32 - shift);
+	for (size_t i = n - 1; i > 0; --i) {
+		r[i] = (a[i] << shift) | (a[i - 1] >> (32 - shift));
+	}
+	r[0] = a[0] << shift;
+	return out;
+}
+
+uint32_t rshift_portable(uint32_t *r, uint32_t const *a, size_t n, unsigned shift) {
+	if (n == 0) {
+		return 0;
+	}
+	uint32_t out = a[0] << (32 - shift);
+	for (size_t i = 0; i + 1 < n; ++i) {
+		r[i] = (a[i] >> shift) | (a[i + 1] << (32 - shift));
+	}
+	r[n - 1] = a[n - 1] >> shift;
+	return out;
+}
+
+/*
+ * Divides by a precomputed reciprocal instead of the hardware divider
+ * (Moller & Granlund, "Improved division by invariant integers"). The
+ * divisor is shifted so that its top bit is set, and so is the dividend,
+ * one limb at a time.
+ */
+uint32_t divrem_1_portable(uint32_t *q, uint32_t const *a, size_t n, uint32_t d) {
+	if (n == 0) {
+		return 0;
+	}
+	unsigned shift = __builtin_clz(d);
+	d <<= shift;
+	uint32_t inverse = static_cast<uint32_t>(UINT64_MAX / d - (UINT64_C(1) << 32));
+
+	uint32_t remainder = shift ? a[n - 1] >> (32 - shift) : 0;
+	for (size_t i = n; i-- > 0;) {
+		uint32_t low = a[i] << shift;
+		if (shift && i > 0) {
+			low |= a[i - 1] >> (32 - shift);
+		}
+		uint64_t estimate = static_cast<uint64_t>(inverse) * remainder
+			+ ((static_cast<uint64_t>(remainder) << 32) | low);
+		uint32_t quotient = static_cast<uint32_t>(estimate >> 32) + 1;
+		remainder = low - quotient * d;
+		if (remainder > static_cast<uint32_t>(estimate)) {
+			--quotient;
+			remainder += d;
+		}
+		if (remainder >= d) {
+			++quotient;
+			remainder -= d;
+		}
+		q[i] = quotient;
+	}
+	return remainder >> shift;
+}
+
+size_t popcount_portable(uint32_t const *a, size_t n) {
+	size_t count = 0;
+	for (size_t i = 0; i < n; ++i) {
+		count += __builtin_popcount(a[i]);
+	}
+	return count;
+}
+
+limb_kernels const portable_kernels = {
+	"portable",
+	add_n_portable,
+	sub_n_portable,
+	mul_1_portable,
+	addmul_1_portable,
+	submul_1_portable,
+	lshift_portable,
+	rshift_portable,
+	divrem_1_portable,
+	popcount_portable,
+};
+
+#ifdef BIGINT_X86_KERNELS
+
+/* * * * * * * * * BMI2, ADX & POPCNT kernels * * * * * * * * * */
+
+// Pairs of limbs are handled as one 64-bit word, x86 is little-endian.
+__extension__ typedef unsigned __int128 uint128;
+
+inline uint64_t load_pair(uint32_t const *p) {
+	uint64_t word;
+	std::memcpy(&word, p, sizeof(word));
+	return word;
+}
+
+inline void store_pair(uint32_t *p, uint64_t word) {
+	std::memcpy(p, &word, sizeof(word));
+}
+
+__attribute__((target("bmi2,adx")))
+uint32_t add_n_adx(uint32_t *r, uint32_t const *a, uint32_t const *b, size_t n) {
+	unsigned char carry = 0;
+	size_t i = 0;
+	for (; i + 2 <= n; i += 2) {
+		unsigned long long sum;
+		carry = _addcarryx_u64(carry, load_pair(a + i), load_pair(b + i), &sum);
+		store_pair(r + i, sum);
+	}
+	if (i < n) {
+		uint64_t sum = static_cast<uint64_t>(a[i]) + b[i] + carry;
+		r[i] = static_cast<uint32_t>(sum);
+		carry = static_cast<unsigned char>(sum >> 32);
+	}
+	return carry;
+}
+
+__attribute__((target("bmi2,adx")))
+uint32_t sub_n_adx(uint32_t *r, uint32_t const *a, uint32_t const *b, size_t n) {
+	unsigned char borrow = 0;
+	size_t i = 0;
+	for (; i + 2 <= n; i += 2) {
+		unsigned long long difference;
+		borrow = _subborrow_u64(borrow, load_pair(a + i), load_pair(b + i), &difference);
+		store_pair(r + i, difference);
+	}
+	if (i < n) {
+		uint64_t difference = static_cast<uint64_t>(a[i]) - b[i] - borrow;
+		r[i] = static_cast<uint32_t>(difference);
+		borrow = static_cast<unsigned char>(difference >> 63);
+	}
+	return borrow;
+}
+
+__attribute__((target("bmi2,adx")))
+uint32_t mul_1_bmi2(uint32_t *r, uint32_t const *a, size_t n, uint32_t b) {
+	uint64_t carry = 0;
+	size_t i = 0;
+	for (; i + 2 <= n; i += 2) {
+		uint128 product = static_cast<uint128>(load_pair(a + i)) * b + carry;
+		store_pair(r + i, static_cast<uint64_t>(product));
+		carry = static_cast<uint64_t>(product >> 64);
+	}
+	if (i < n) {
+		uint64_t product = static_cast<uint64_t>(a[i]) * b + carry;
+		r[i] = static_cast<uint32_t>(product);
+		carry = product >> 32;
+	}
+	return static_cast<uint32_t>(carry);
+}
+
+__attribute__((target("bmi2,adx")))
+uint32_t addmul_1_bmi2(uint32_t *r, uint32_t const *a, size_t n, uint32_t b) {
+	uint64_t carry = 0;
+	size_t i = 0;
+	for (; i + 2 <= n; i += 2) {
+		uint128 product = static_cast<uint128>(load_pair(a + i)) * b + load_pair(r + i) + carry;
+		store_pair(r + i, static_cast<uint64_t>(product));
+		carry = static_cast<uint64_t>(product >> 64);
+	}
+	if (i < n) {
+		uint64_t product = static_cast<uint64_t>(a[i]) * b + r[i] + carry;
+		r[i] = static_cast<uint32_t>(product);
+		carry = product >> 32;
+	}
+	return static_cast<uint32_t>(carry);
+}
+
+__attribute__((target("bmi2,adx")))
+uint32_t submul_1_bmi2(uint32_t *r, uint32_t const *a, size_t n, uint32_t b) {
+	uint64_t borrow = 0;
+	size_t i = 0;
+	for (; i + 2 <= n; i += 2) {
+		uint128 product = static_cast<uint128>(load_pair(a + i)) * b + borrow;
+		uint64_t low = static_cast<uint64_t>(product);
+		uint64_t word = load_pair(r + i);
+		store_pair(r + i, word - low);
+		borrow = static_cast<uint64_t>(product >> 64) + (word < low);
+	}
+	if (i < n) {
+		uint64_t product = static_cast<uint64_t>(a[i]) * b + borrow;
+		uint32_t low = static_cast<uint32_t>(product);
+		uint32_t digit = r[i];
+		r[i] = digit - low;
+		borrow = (product >> 32) + (digit < low);
+	}
+	return static_cast<uint32_t>(borrow);
+}
+
+__attribute__((target("popcnt")))
+size_t popcount_popcnt(uint32_t const *a, size_t n) {
+	size_t count = 0;
+	size_t i = 0;
+	for (; i + 2 <= n; i += 2) {
+		count += __builtin_popcountll(load_pair(a + i));
+	}
+	if (i < n) {
+		count += __builtin_popcount(a[i]);
+	}
+	return count;
+}
+
+/* * * * * * * * * AVX2 & AVX-512 kernels * * * * * * * * * */
+
+// Shifts have no carry chain, so they are the loops that vectorise.
+// Each block is loaded whole before it is stored, which keeps r == a safe.
+
+__attribute__((target("avx2")))
+uint32_t lshift_avx2(uint32_t *r, uint32_t const *a, size_t n, unsigned shift) {
+	if (n == 0) {
+		return 0;
+	}
+	uint32_t out = a[n - 1] >> (32 - shift);
+	__m128i left = _mm_cvtsi32_si128(static_cast<int>(shift));
+	__m128i right = _mm_cvtsi32_si128(static_cast<int>(32 - shift));
+	size_t i = n;
+	for (; i >= 9; i -= 8) {
+		__m256i high = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(a + i - 8));
+		__m256i low = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(a + i - 9));
+		_mm256_storeu_si256(reinterpret_cast<__m256i *>(r + i - 8),
+							_mm256_or_si256(_mm256_sll_epi32(high, left), _mm256_srl_epi32(low, right)));
+	}
+	for (; i > 1; --i) {
+		r[i - 1] = (a[i - 1] << shift) | (a[i - 2] >> (32 - shift));
+	}
+	r[0] = a[0] << shift;
+	return out;
+}
+
+__attribute__((target("avx2")))
+uint32_t rshift_avx2(uint32_t *r, uint32_t const *a, size_t n, unsigned shift) {
+	if (n == 0) {
+		return 0;
+	}
+	uint32_t out = a[0] << (32 - shift);
+	__m128i right = _mm_cvtsi32_si128(static_cast<int>(shift));
+	__m128i left = _mm_cvtsi32_si128(static_cast<int>(32 - shift));
+	size_t i = 0;
+	for (; i + 9 <= n; i += 8) {
+		__m256i low = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(a + i));
+		__m256i high = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(a + i + 1));
+		_mm256_storeu_si256(reinterpret_cast<__m256i *>(r + i),
+							_mm256_or_si256(_mm256_srl_epi32(low, right), _mm256_sll_epi32(high, left)));
+	}
+	for (; i + 1 < n; ++i) {
+		r[i] = (a[i] >> shift) | (a[i + 1] << (32 - shift));
+	}
+	r[n - 1] = a[n - 1] >> shift;
+	return out;
+}
+
+// The zero-masking forms keep GCC from warning about the unmasked ones.
+__mmask16 const ALL_LANES = 0xFFFF;
+
+__attribute__((target("avx512f")))
+uint32_t lshift_avx512(uint32_t *r, uint32_t const *a, size_t n, unsigned shift) {
+	if (n == 0) {
+		return 0;
+	}
+	uint32_t out = a[n - 1] >> (32 - shift);
+	__m128i left = _mm_cvtsi32_si128(static_cast<int>(shift));
+	__m128i right = _mm_cvtsi32_si128(static_cast<int>(32 - shift));
+	size_t i = n;
+	for (; i >= 17; i -= 16) {
+		__m512i high = _mm512_loadu_si512(a + i - 16);
+		__m512i low = _mm512_loadu_si512(a + i - 17);
+		_mm512_storeu_si512(r + i - 16, _mm512_or_si512(_mm512_maskz_sll_epi32(ALL_LANES, high, left),
+												  _mm512_maskz_srl_epi32(ALL_LANES, low, right)));
+	}
+	for (; i > 1; --i) {
+		r[i - 1] = (a[i - 1] << shift) | (a[i - 2] >> (32 - shift));
+	}
+	r[0] = a[0] << shift;
+	return out;
+}
+
+__attribute__((target("avx512f")))
+uint32_t rshift_avx512(uint32_t *r, uint32_t const *a, size_t n, unsigned shift) {
+	if (n == 0) {
+		return 0;
+	}
+	uint32_t out = a[0] << (32 - shift);
+	__m128i right = _mm_cvtsi32_si128(static_cast<int>(shift));
+	__m128i left = _mm_cvtsi32_si128(static_cast<int>(32 - shift));
+	size_t i = 0;
+	for (; i + 17 <= n; i += 16) {
+		__m512i low = _mm512_loadu_si512(a + i);
+		__m512i high = _mm512_loadu_si512(a + i + 1);
+		_mm512_storeu_si512(r + i, _mm512_or_si512(_mm512_maskz_srl_epi32(ALL_LANES, low, right),
+												  _mm512_maskz_sll_epi32(ALL_LANES, high, left)));
+	}
+	for (; i + 1 < n; ++i) {
+		r[i] = (a[i] >> shift) | (a[i + 1] << (32 - shift));
+	}
+	r[n - 1] = a[n - 1] >> shift;
+	return out;
+}
+
+#endif
+
+limb_kernels select_kernels() {
+	limb_kernels res = portable_kernels;
+#ifdef BIGINT_X86_KERNELS
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("popcnt")) {
+		res.popcount = popcount_popcnt;
+	}
+	if (__builtin_cpu_supports("bmi2") && __builtin_cpu_supports("adx")) {
+		res.name = "bmi2-adx";
+		res.add_n = add_n_adx;
+		res.sub_n = sub_n_adx;
+		res.mul_1 = mul_1_bmi2;
+		res.addmul_1 = addmul_1_bmi2;
+		res.submul_1 = submul_1_bmi2;
+	}
+	if (__builtin_cpu_supports("avx512f")) {
+		res.name = res.add_n == add_n_adx ? "bmi2-adx+avx512" : "avx512";
+		res.lshift = lshift_avx512;
+		res.rshift = rshift_avx512;
+	} else if (__builtin_cpu_supports("avx2")) {
+		res.name = res.add_n == add_n_adx ? "bmi2-adx+avx2" : "avx2";
+		res.lshift = lshift_avx2;
+		res.rshift = rshift_avx2;
+	}
+#endif
+	return res;
+}
+}
+
+limb_kernels const &limb_kernels::get() {
+	static limb_kernels const selected = select_kernels();
+	return selected;
+}
+
+limb_kernels const &limb_kernels::portable() {
+	return portable_kernels;
+}
@@ -0,0 +1,71 @@
+#ifndef BIGINT__LIMB_KERNELS_H_
+#define BIGINT__LIMB_KERNELS_H_
+
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * Inner loops over little-endian arrays of 32-bit limbs, in the spirit of
+ * GMP's mpn layer. The result may be written over an input of the same
+ * length (r == a, and r == b for add_n and sub_n), but not over a shifted
+ * copy of it. Every kernel that writes r returns the limb that does not fit
+ * into it: a carry, a borrow, the high limb of a product, the bits shifted
+ * out or a remainder.
+ *
+ * get() returns the fastest table the CPU supports, detected once through
+ * CPUID; portable() is the plain C++ fallback every other table agrees with.
+ */
+struct limb_kernels {
+	char const *name;
+
+	// r = a + b, returns the carry
+	uint32_t (*add_n)(uint32_t *r, uint32_t const *a, uint32_t const *b, size_t n);
+	// r = a - b, returns the borrow
+	uint32_t (*sub_n)(uint32_t *r, uint32_t const *a, uint32_t const *b, size_t n);
+	// r = a * b, returns the high limb
+	uint32_t (*mul_1)(uint32_t *r, uint32_t const *a, size_t n, uint32_t b);
+	// r += a * b, returns the high limb
+	uint32_t (*addmul_1)(uint32_t *r, uint32_t const *a, size_t n, uint32_t b);
+	// r -= a * b, returns the borrowed high limb
+	uint32_t (*submul_1)(uint32_t *r, uint32_t const *a, size_t n, uint32_t b);
+	// r = a << shift for 0 < shift < 32, returns the bits pushed out at the top
+	uint32_t (*lshift)(uint32_t *r, uint32_t const *a, size_t n, unsigned shift);
+	// r = a >> shift for 0 < shift < 32, returns the bits pushed out at the
+	// bottom in the high end of the limb
+	uint32_t (*rshift)(uint32_t *r, uint32_t const *a, size_t n, unsigned shift);
+	// q = a / d for d != 0, returns the remainder
+	uint32_t (*divrem_1)(uint32_t *q, uint32_t const *a, size_t n, uint32_t d);
+	// number of set bits in a
+	size_t (*popcount)(uint32_t const *a, size_t n);
+
+	static limb_kernels const &get();
+	static limb_kernels const &portable();
+
+	// r = a + b for a single limb b, returns the carry
+	static uint32_t add_1(uint32_t *r, uint32_t const *a, size_t n, uint32_t b) {
+		for (size_t i = 0; i < n; ++i) {
+			if (b == 0 && r == a) {
+				break;
+			}
+			uint32_t sum = a[i] + b;
+			b = sum < b;
+			r[i] = sum;
+		}
+		return b;
+	}
+
+	// r = a - b for a single limb b, returns the borrow
+	static uint32_t sub_1(uint32_t *r, uint32_t const *a, size_t n, uint32_t b) {
+		for (size_t i = 0; i < n; ++i) {
+			if (b == 0 && r == a) {
+				break;
+			}
+			uint32_t digit = a[i];
+			r[i] = digit - b;
+			b = digit < b;
+		}
+		return b;
+	}
+};
+
+#endif //BIGINT__LIMB_KERNELS_H_
@@ -5,14 +5,23 @@
 #ifndef BIGINT__SHARED_VECTOR_H_
 #define BIGINT__SHARED_VECTOR_H_
 
+#include <atomic>
+
 class shared_vector {
-	uint32_t ref_counter;
+	std::atomic<uint32_t> ref_counter;
 	std::vector<uint32_t> data;
 
  public:
 	shared_vector() : ref_counter(1), data(0) {};
 
 	shared_vector(std::vector<uint32_t> const &other) : ref_counter(1), data(other) {};
+
+	// Copies [first, last) into storage with room for capacity elements
+	shared_vector(uint32_t const *first, uint32_t const *last, size_t capacity) : ref_counter(1) {
+		data.reserve(capacity);
+		data.assign(first, last);
+	}
+
 	shared_vector(shared_vector const &other) : ref_counter(1), data(other.data) {};
 
 	~shared_vector() = default;
@@ -23,8 +32,9 @@ class shared_vector {
 
 	shared_vector *unshare() {
 		if (use_count() != 1) {
-			--ref_counter;
-			return new shared_vector(*this);
+			shared_vector *copy = new shared_vector(*this);
+			destroy();
+			return copy;
 		}
 		return this;
 	}
@@ -37,6 +47,14 @@ class shared_vector {
 		return data[pos];
 	}
 
+	uint32_t *begin() {
+		return data.data();
+	}
+
+	uint32_t const *begin() const {
+		return data.data();
+	}
+
 	bool operator==(shared_vector const& other) {
 		return data == other.data;
 	}
@@ -45,6 +63,18 @@ class shared_vector {
 		data.resize(sz);
 	}
 
+	size_t capacity() const {
+		return data.capacity();
+	}
+
+	void reserve(size_t capacity) {
+		data.reserve(capacity);
+	}
+
+	void shrink_to_fit() {
+		data.shrink_to_fit();
+	}
+
 	void push_back(uint32_t const &element) {
 		data.push_back(element);
 	}
@@ -58,8 +88,7 @@ class shared_vector {
 	}
 
 	void destroy() {
-		ref_counter--;
-		if (use_count() == 0) {
+		if (--ref_counter == 0) {
 			delete this;
 		}
 	}
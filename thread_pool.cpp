@@ -0,0 +1,136 @@
+#include "thread_pool.h"
+
+#include <utility>
+
+namespace {
+thread_local thread_pool const *current_pool = nullptr;
+thread_local size_t current_index = 0;
+}
+
+/* * * * * * * * * Pool * * * * * * * * * */
+
+thread_pool::thread_pool(size_t workers) : queued_(0), stop_(false) {
+	for (size_t i = 0; i <= workers; ++i) {
+		queues_.emplace_back(new worker_queue());
+	}
+	for (size_t i = 0; i < workers; ++i) {
+		workers_.emplace_back(&thread_pool::worker_loop, this, i);
+	}
+}
+
+thread_pool::~thread_pool() {
+	{
+		std::lock_guard<std::mutex> lock(sleep_lock_);
+		stop_ = true;
+	}
+	wake_.notify_all();
+	for (std::thread &worker : workers_) {
+		worker.join();
+	}
+}
+
+size_t thread_pool::own_queue() const {
+	return current_pool == this ? current_index : workers_.size();
+}
+
+void thread_pool::push(std::function<void()> task) {
+	size_t index = own_queue();
+	{
+		std::lock_guard<std::mutex> lock(queues_[index]->lock);
+		queues_[index]->tasks.push_back(std::move(task));
+	}
+	{
+		std::lock_guard<std::mutex> lock(sleep_lock_);
+		++queued_;
+	}
+	wake_.notify_one();
+}
+
+bool thread_pool::try_run_one(bool steal) {
+	size_t count = steal ? queues_.size() : 1;
+	size_t own = own_queue();
+	std::function<void()> task;
+
+	for (size_t i = 0; i < count && !task; ++i) {
+		worker_queue &queue = *queues_[(own + i) % queues_.size()];
+		std::lock_guard<std::mutex> lock(queue.lock);
+		if (queue.tasks.empty()) {
+			continue;
+		}
+		if (i == 0) {
+			task = std::move(queue.tasks.back());
+			queue.tasks.pop_back();
+		} else {
+			task = std::move(queue.tasks.front());
+			queue.tasks.pop_front();
+		}
+	}
+
+	if (!task) {
+		return false;
+	}
+	--queued_;
+	task();
+	return true;
+}
+
+void thread_pool::worker_loop(size_t index) {
+	current_pool = this;
+	current_index = index;
+	while (true) {
+		if (try_run_one(true)) {
+			continue;
+		}
+		std::unique_lock<std::mutex> lock(sleep_lock_);
+		wake_.wait(lock, [this] { return stop_ || queued_ > 0; });
+		if (stop_ && queued_ == 0) {
+			return;
+		}
+	}
+}
+
+/* * * * * * * * * Task group * * * * * * * * * */
+
+thread_pool::task_group::~task_group() {
+	join();
+}
+
+/*
+ * The group's tasks were all pushed by this thread, so once its deque is
+ * empty every one of them has been taken by a thread that will finish it.
+ * Taking done_lock_ even when nothing is left waits out the last task's
+ * notify, which would otherwise race with the group's destruction.
+ */
+void thread_pool::task_group::join() {
+	while (pending_ > 0 && pool_.try_run_one(false)) {
+	}
+	std::unique_lock<std::mutex> lock(done_lock_);
+	done_.wait(lock, [this] { return pending_ == 0; });
+}
+
+void thread_pool::task_group::run(std::function<void()> task) {
+	++pending_;
+	pool_.push([this, task] {
+		try {
+			task();
+		} catch (...) {
+			std::lock_guard<std::mutex> lock(error_lock_);
+			if (!error_) {
+				error_ = std::current_exception();
+			}
+		}
+		std::lock_guard<std::mutex> lock(done_lock_);
+		if (--pending_ == 0) {
+			done_.notify_all();
+		}
+	});
+}
+
+void thread_pool::task_group::wait() {
+	join();
+	if (error_) {
+		std::exception_ptr error = error_;
+		error_ = nullptr;
+		std::rethrow_exception(error);
+	}
+}
@@ -0,0 +1,75 @@
+#ifndef BIGINT__THREAD_POOL_H_
+#define BIGINT__THREAD_POOL_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+ * Work-stealing pool. Every worker owns a deque: it pops its own tasks from
+ * the back and steals from the front of the others' deques when it runs dry.
+ * Threads outside the pool share one extra deque. A thread waiting on a
+ * task_group keeps running tasks from its own deque, so nested forks cannot
+ * deadlock the pool, but it never steals, so its stack stays as deep as the
+ * fork tree. Once its deque is empty the rest of the group was stolen, and
+ * it sleeps until the thieves finish it.
+ */
+class thread_pool {
+	struct worker_queue {
+		std::mutex lock;
+		std::deque<std::function<void()>> tasks;
+	};
+
+	std::vector<std::unique_ptr<worker_queue>> queues_;
+	std::vector<std::thread> workers_;
+	std::atomic<size_t> queued_;
+	std::mutex sleep_lock_;
+	std::condition_variable wake_;
+	bool stop_;
+
+	void push(std::function<void()> task);
+	size_t own_queue() const;
+	bool try_run_one(bool steal);
+	void worker_loop(size_t index);
+
+ public:
+	explicit thread_pool(size_t workers);
+	~thread_pool();
+
+	thread_pool(thread_pool const &other) = delete;
+	thread_pool &operator=(thread_pool const &other) = delete;
+
+	size_t size() const {
+		return workers_.size();
+	}
+
+	class task_group {
+		thread_pool &pool_;
+		std::atomic<size_t> pending_;
+		std::mutex error_lock_;
+		std::exception_ptr error_;
+		std::mutex done_lock_;
+		std::condition_variable done_;
+
+		void join();
+
+	 public:
+		explicit task_group(thread_pool &pool) : pool_(pool), pending_(0) {}
+		~task_group();
+
+		task_group(task_group const &other) = delete;
+		task_group &operator=(task_group const &other) = delete;
+
+		void run(std::function<void()> task);
+		void wait();
+	};
+};
+
+#endif //BIGINT__THREAD_POOL_H_
@@ -0,0 +1,214 @@
+/*
+ * Re-runs a trace written by big_integer::start_trace against the current
+ * build and reports the time spent per operation and operand size.
+ *
+ *   trace_replay <trace file>
+ *
+ * Operands are rebuilt from the recorded values, or when the trace has none,
+ * drawn at random with the recorded signs and limb counts. Sizes are
+ * bucketed by the larger operand, in powers of two limbs. Text conversions
+ * are also split by base and bit import and export by word size, as those
+ * change the algorithm.
+ */
+
+#include "../big_integer.h"
+#include "../big_integer_io.h"
+#include "../big_integer_trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+namespace {
+struct bucket_stats {
+	size_t count = 0;
+	uint64_t nanoseconds = 0;
+	size_t skipped = 0;
+};
+
+// Bucket 0 holds empty operands, bucket k holds [2^(k - 1), 2^k) limbs
+size_t size_bucket(uint64_t limbs) {
+	return limbs == 0 ? 0 : 64 - __builtin_clzll(limbs);
+}
+
+// The base or word size for operations whose cost depends on it, 0 for the rest
+uint64_t variant(trace_record const &record) {
+	bool keyed = trace_op_has_argument(record.op)
+		&& record.op != trace_op::shift_left
+		&& record.op != trace_op::shift_right;
+	return keyed ? record.rhs_size : 0;
+}
+
+std::ios_base::fmtflags stream_flags(unsigned base) {
+	return base == 16 ? std::ios_base::hex : base == 8 ? std::ios_base::oct : std::ios_base::dec;
+}
+
+big_integer operand(std::vector<uint32_t> const &limbs, uint64_t size, bool negative, std::mt19937_64 &random) {
+	big_integer res;
+	if (!limbs.empty() || size == 0) {
+		res = big_integer(big_integer_view(limbs.data(), limbs.size()));
+	} else {
+		// top limb nonzero so the value has exactly the recorded size
+		res = big_integer::random_bits(32 * size, std::ref(random));
+		res.set_bit(32 * size - 1);
+	}
+	return negative ? -res : res;
+}
+}
+
+int main(int argc, char **argv) {
+	if (argc != 2) {
+		std::cerr << "usage: " << argv[0] << " <trace file>\n";
+		return 2;
+	}
+	std::ifstream in(argv[1], std::ios::binary);
+	if (!in) {
+		std::cerr << argv[1] << ": cannot open\n";
+		return 1;
+	}
+
+	std::map<std::tuple<trace_op, uint64_t, size_t>, bucket_stats> stats;
+	std::mt19937_64 random(0x5eed);
+	size_t sink = 0;
+	try {
+		trace_reader reader(in);
+		trace_record record;
+		while (reader.next(record)) {
+			big_integer lhs = operand(record.lhs, record.lhs_size, record.lhs_negative, random);
+			bool argument = trace_op_has_argument(record.op);
+			big_integer rhs;
+			if (!argument) {
+				rhs = operand(record.rhs, record.rhs_size, record.rhs_negative, random);
+			}
+			uint64_t largest = argument ? record.lhs_size : std::max(record.lhs_size, record.rhs_size);
+			bucket_stats &bucket = stats[std::make_tuple(record.op, variant(record), size_bucket(largest))];
+
+			// inputs of the reads and buffers of the writes are prepared outside the timing
+			uint32_t shift = static_cast<uint32_t>(record.rhs_size);
+			unsigned base = static_cast<unsigned>(record.rhs_size);
+			bits_format format;
+			format.word_size = std::max<size_t>(record.rhs_size, 1);
+			std::string text;
+			std::vector<unsigned char> bits;
+			size_t words = 0;
+			std::ostringstream out;
+			std::istringstream in;
+			switch (record.op) {
+				case trace_op::from_string: text = to_string(lhs, base);
+					break;
+				case trace_op::write_text: out.flags(stream_flags(base));
+					break;
+				case trace_op::read_text: in.str(to_string(lhs, base));
+					in.flags(stream_flags(base));
+					break;
+				case trace_op::export_bits:
+				case trace_op::import_bits: words = lhs.export_bits(nullptr, 0, format);
+					bits.resize(words * format.word_size);
+					lhs.export_bits(bits.data(), words, format);
+					break;
+				case trace_op::read_binary: write_binary(out, lhs);
+					in.str(out.str());
+					break;
+				default: break;
+			}
+			if ((record.op == trace_op::divide || record.op == trace_op::remainder) && record.rhs_size == 0) {
+				++bucket.skipped;
+				continue;
+			}
+
+			auto start = std::chrono::steady_clock::now();
+			switch (record.op) {
+				case trace_op::add: sink += (lhs + rhs).capacity();
+					break;
+				case trace_op::subtract: sink += (lhs - rhs).capacity();
+					break;
+				case trace_op::multiply: sink += (lhs * rhs).capacity();
+					break;
+				case trace_op::divide: sink += (lhs / rhs).capacity();
+					break;
+				case trace_op::remainder: sink += (lhs % rhs).capacity();
+					break;
+				case trace_op::bit_and: sink += (lhs & rhs).capacity();
+					break;
+				case trace_op::bit_or: sink += (lhs | rhs).capacity();
+					break;
+				case trace_op::bit_xor: sink += (lhs ^ rhs).capacity();
+					break;
+				case trace_op::shift_left: sink += (lhs << shift).capacity();
+					break;
+				case trace_op::shift_right: sink += (lhs >> shift).capacity();
+					break;
+				case trace_op::equal: sink += lhs == rhs;
+					break;
+				case trace_op::less: sink += lhs < rhs;
+					break;
+				case trace_op::to_string: sink += to_string(lhs, base).size();
+					break;
+				case trace_op::from_string: sink += big_integer(text, base).capacity();
+					break;
+				case trace_op::write_text: out << lhs;
+					break;
+				case trace_op::read_text: in >> rhs;
+					break;
+				case trace_op::export_bits: sink += lhs.export_bits(bits.data(), words, format);
+					break;
+				case trace_op::import_bits:
+					sink += big_integer::import_bits(bits.data(), words, format, record.lhs_negative).capacity();
+					break;
+				case trace_op::write_binary: write_binary(out, lhs);
+					break;
+				case trace_op::read_binary: sink += read_binary(in).capacity();
+					break;
+			}
+			sink += static_cast<size_t>(out.tellp()) + rhs.capacity();
+			auto elapsed = std::chrono::steady_clock::now() - start;
+			++bucket.count;
+			bucket.nanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+		}
+	} catch (std::exception const &e) {
+		std::cerr << argv[1] << ": " << e.what() << "\n";
+		return 1;
+	}
+
+	std::printf("%-16s %-16s %10s %12s %12s\n", "operation", "limbs", "count", "total ms", "mean ns");
+	size_t total_count = 0;
+	uint64_t total_nanoseconds = 0;
+	for (auto const &entry : stats) {
+		std::string name = trace_op_name(std::get<0>(entry.first));
+		if (std::get<1>(entry.first)) {
+			name += "/" + std::to_string(std::get<1>(entry.first));
+		}
+		size_t bucket = std::get<2>(entry.first);
+		bucket_stats const &s = entry.second;
+		std::string limbs = std::to_string(bucket == 0 ? 0 : uint64_t(1) << (bucket - 1));
+		if (bucket > 1) {
+			limbs += "-" + std::to_string((uint64_t(1) << bucket) - 1);
+		}
+		std::printf("%-16s %-16s %10zu %12.3f %12.0f",
+					name.c_str(),
+					limbs.c_str(),
+					s.count,
+					s.nanoseconds / 1e6,
+					s.count ? static_cast<double>(s.nanoseconds) / s.count : 0.0);
+		if (s.skipped) {
+			std::printf("  (%zu divisions by zero skipped)", s.skipped);
+		}
+		std::printf("\n");
+		total_count += s.count;
+		total_nanoseconds += s.nanoseconds;
+	}
+	std::printf("%-16s %-16s %10zu %12.3f\n", "total", "", total_count, total_nanoseconds / 1e6);
+	return sink == SIZE_MAX;
+}